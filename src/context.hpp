@@ -5,9 +5,14 @@
 #include "event_loop.hpp"
 #include "types.hpp"
 
+class display;
+
 class context {
 public:
     virtual event_loop & get_el() = 0;
     virtual void set_mouse_pos(mouse_pos_t const &) = 0;
-    virtual void mouse_at_border(mouse_pos_t const &) = 0;
+    // mp.screen is the screen of the display reporting the border
+    virtual void mouse_at_border(display const &, mouse_pos_t const &) = 0;
+    // the session of the display is idle: screensaver, lock or monitors powered down
+    virtual void set_idle(display const &, bool) = 0;
 };
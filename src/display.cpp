@@ -2,145 +2,597 @@
 
 #include "display.hpp"
 
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
-#include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
 
 #include "types.hpp"
 
-static const char screen_config_file[] = "/etc/lmss.sl";
-
 static const int BORDER_WIDTH = 1;
 static const int BORDER_CLEARANCE = 1;
-static const int RESOLUTION = 65536;
+// the X server's virtual core pointer, new devices like the uinput pointer are attached to it
+static const xcb_input_device_id_t CORE_POINTER = 2;
+
+// sequence numbers wrap around, a is before b if it is less than half the range behind
+static bool before(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) < 0;
+}
 
-display::display(logger & log, context & ctx)
+display::display(logger & log, context & ctx, options const & opts, std::string const & name)
     : log(log)
-    , ctx(ctx) {
+    , ctx(ctx)
+    , opts(opts)
+    , active(CORE_POINTER) {
+
+    int screen_num = 0;
+    conn = conn_t(xcb_connect(name.empty() ? nullptr : name.c_str(), &screen_num));
+
+    if (xcb_connection_has_error(conn.get())) {
+        throw std::runtime_error("Failed to open display " + name);
+    }
+
+    for (auto it = xcb_setup_roots_iterator(xcb_get_setup(conn.get())); it.rem; xcb_screen_next(&it)) {
+        roots.push_back(it.data->root);
+    }
+    default_root = roots.at(screen_num);
+
+    check_extensions();
+
+    event_windows = roots;
+    if (rr_event_base) {
+        for (auto root : roots) {
+            xcb_randr_select_input(conn.get(), root, XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE
+                | XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE | XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+        }
+    }
+
+    if (!opts.layout_file.empty()) {
+        watch_screen_layout_file();
+    }
+    load_screen_layout();
+
+    if (opts.uinput) {
+        pointer.emplace(log, screen_layout.width(), screen_layout.height());
+    }
+
+    if (opts.evdev) {
+        evdev.emplace(log, ctx.get_el(), std::bind(&display::handle_relative_motion, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    } else if (!opts.barriers) {
+        track_devices = true;
+        query_devices();
+    }
+
+    // the selections of all screens are checked with a single round trip
+    std::vector<xcb_void_cookie_t> selects;
+    for (auto win : event_windows) {
+        selects.push_back(subscribe_to_events(win));
+    }
+    for (auto cookie : selects) {
+        if (reply_t<xcb_generic_error_t> error { xcb_request_check(conn.get(), cookie) }) {
+            throw std::runtime_error("failed to select XI events, error: " + std::to_string(error->error_code));
+        }
+    }
 
-    auto dsp_var = getenv("DISPLAY");
-    dsp = dsp_t(XOpenDisplay(dsp_var));
+    // the uinput device may have been added before the hierarchy events were selected
+    if (pointer && !pointer_attached) {
+        query_devices();
+    }
 
-    if (!dsp) {
-        throw std::runtime_error("Failed to open display");
+    // the screensaver tells when the session goes idle, DPMS is asked when its timeout is due
+    if (ss_event_base) {
+        for (auto root : roots) {
+            xcb_screensaver_select_input(conn.get(), root, XCB_SCREENSAVER_EVENT_NOTIFY_MASK);
+        }
+    }
+    if (dpms) {
+        idle_timer = file_descriptor(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+        if (!idle_timer.valid()) {
+            throw std::system_error(errno, std::system_category(), "failed to create idle timer");
+        }
+        ctx.get_el().add_fd(*idle_timer, std::bind(&display::handle_idle_timer, this, std::placeholders::_1));
     }
 
-    int event, error;
-    if (!XQueryExtension(dsp.get(), "XInputExtension", &xi_opcode, &event, &error)) {
+    ctx.get_el().add_fd(xcb_get_file_descriptor(conn.get()),
+        std::bind(&display::handle_events, this, std::placeholders::_1));
+}
+
+void display::check_extensions() {
+    // the extension queries and the version requests are sent before any reply is awaited
+    xcb_prefetch_extension_data(conn.get(), &xcb_input_id);
+    xcb_prefetch_extension_data(conn.get(), &xcb_randr_id);
+    xcb_prefetch_extension_data(conn.get(), &xcb_xfixes_id);
+    xcb_prefetch_extension_data(conn.get(), &xcb_screensaver_id);
+    xcb_prefetch_extension_data(conn.get(), &xcb_dpms_id);
+
+    auto xi = xcb_get_extension_data(conn.get(), &xcb_input_id);
+    if (!xi || !xi->present) {
         throw std::runtime_error("XInput extension not supported");
     }
+    xi_opcode = xi->major_opcode;
+    // raw events of master devices came with 2.1, barrier events with 2.3
+    auto xi_cookie = xcb_input_xi_query_version(conn.get(), 2, opts.barriers ? 3 : 1);
+
+    // without RandR the layout can still come from the layout file
+    std::optional<xcb_randr_query_version_cookie_t> rr_cookie;
+    auto rr = xcb_get_extension_data(conn.get(), &xcb_randr_id);
+    if (rr && rr->present) {
+        rr_cookie = xcb_randr_query_version(conn.get(), 1, 5);
+    }
+
+    auto xfixes = xcb_get_extension_data(conn.get(), &xcb_xfixes_id);
+    if (!xfixes || !xfixes->present) {
+        throw std::runtime_error("XFixes extension not supported");
+    }
+    auto xfixes_cookie = xcb_xfixes_query_version(conn.get(), 5, 0);
+
+    // both only tell when the session is idle, lmss works without them
+    std::optional<xcb_screensaver_query_version_cookie_t> ss_cookie;
+    auto ss = xcb_get_extension_data(conn.get(), &xcb_screensaver_id);
+    if (ss && ss->present) {
+        ss_cookie = xcb_screensaver_query_version(conn.get(), 1, 1);
+    }
+    std::optional<xcb_dpms_get_version_cookie_t> dpms_cookie;
+    auto dpms_ext = xcb_get_extension_data(conn.get(), &xcb_dpms_id);
+    if (dpms_ext && dpms_ext->present) {
+        dpms_cookie = xcb_dpms_get_version(conn.get(), 1, 1);
+    }
 
-    int major = 2;
-    int minor = 0;
-    int retval = XIQueryVersion(dsp.get(), &major, &minor);
-    if (retval != Success) {
+    reply_t<xcb_input_xi_query_version_reply_t> xi_version {
+        xcb_input_xi_query_version_reply(conn.get(), xi_cookie, nullptr) };
+    if (!xi_version || xi_version->major_version < 2) {
         throw std::runtime_error("XInput 2.0 not supported");
     }
+    if (opts.barriers && xi_version->major_version == 2 && xi_version->minor_version < 3) {
+        throw std::runtime_error("XInput 2.3 not supported, pointer barriers are not available");
+    }
+    master_raw = xi_version->major_version > 2 || xi_version->minor_version >= 1;
 
-    if (std::filesystem::exists(screen_config_file)) {
-        read_screen_layout_from_file(screen_config_file);
-    } else {
-        detect_screen_layout();
+    // cursor hiding came with 4.0, pointer barriers with 5.0
+    reply_t<xcb_xfixes_query_version_reply_t> xfixes_version {
+        xcb_xfixes_query_version_reply(conn.get(), xfixes_cookie, nullptr) };
+    if (!xfixes_version || xfixes_version->major_version < 4) {
+        throw std::runtime_error("XFixes 4.0 not supported");
+    }
+    if (opts.barriers && xfixes_version->major_version < 5) {
+        throw std::runtime_error("XFixes 5.0 not supported, pointer barriers are not available");
+    }
+
+    if (rr_cookie) {
+        // monitors are only reported since 1.5
+        reply_t<xcb_randr_query_version_reply_t> rr_version {
+            xcb_randr_query_version_reply(conn.get(), *rr_cookie, nullptr) };
+        if (rr_version && (rr_version->major_version > 1
+            || (rr_version->major_version == 1 && rr_version->minor_version >= 5))) {
+            rr_event_base = rr->first_event;
+        }
+    }
+
+    if (!rr_event_base) {
+        log.warn("XRandR 1.5 not supported, the screen layout has to come from a layout file");
+    }
+
+    if (ss_cookie) {
+        reply_t<xcb_screensaver_query_version_reply_t> ss_version {
+            xcb_screensaver_query_version_reply(conn.get(), *ss_cookie, nullptr) };
+        if (ss_version) {
+            ss_event_base = ss->first_event;
+        }
+    }
+    if (dpms_cookie) {
+        reply_t<xcb_dpms_get_version_reply_t> dpms_version {
+            xcb_dpms_get_version_reply(conn.get(), *dpms_cookie, nullptr) };
+        dpms = dpms_version != nullptr;
+    }
+}
+
+static bool parse_number(std::string_view & s, int & value) {
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc() || value < 0) {
+        return false;
     }
 
-    XSync(dsp.get(), False);
-    xfd = file_descriptor(ConnectionNumber(dsp.get()));
-    ctx.get_el().add_fd(*xfd, std::bind(&display::handle_events, this, std::placeholders::_1));
+    s.remove_prefix(end - s.data());
+    return true;
 }
 
-void display::read_screen_layout_from_file(std::string const & config_file) {
-    std::ifstream cf(config_file);
+static bool parse_char(std::string_view & s, char c) {
+    if (s.empty() || s.front() != c) {
+        return false;
+    }
 
-    std::regex screen_regex("^([0-9]+)x([0-9]+)\\+([0-9]+)\\+([0-9]+$)");
-    std::smatch screen_match;
+    s.remove_prefix(1);
+    return true;
+}
+
+layout display::read_screen_layout_from_file(std::string const & config_file) {
+    std::ifstream cf(config_file);
+    if (!cf) {
+        throw std::runtime_error("failed to open " + config_file);
+    }
 
+    layout l;
     int mon = 0;
     for (std::string line; std::getline(cf, line);) {
-        if (std::regex_search(line, screen_match, screen_regex)) {
-            log.debug("adding screen with config: " + line);
-            auto w = std::stoi(screen_match[1]);
-            auto h = std::stoi(screen_match[2]);
-            auto x = std::stoi(screen_match[3]);
-            auto y = std::stoi(screen_match[4]);
-            auto root = XDefaultRootWindow(dsp.get());
+        // widthxheight+x+y, blank lines are skipped
+        std::string_view s(line);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+            s.remove_suffix(1);
+        }
+        if (s.empty()) {
+            continue;
+        }
 
-            add_monitor(mon, x, y, w, h, root);
+        int w, h, x, y;
+        if (!parse_number(s, w) || !parse_char(s, 'x') || !parse_number(s, h) || !parse_char(s, '+')
+            || !parse_number(s, x) || !parse_char(s, '+') || !parse_number(s, y) || !s.empty()
+            || w == 0 || h == 0) {
 
-        } else {
             throw std::runtime_error("failed to parse screen configuration: " + line);
         }
 
+        log.debug("adding screen with config: " + line);
+        l.add_monitor(mon, x, y, w, h, default_root, BORDER_WIDTH);
         mon++;
     }
 
-    if (mon == 0) {
+    if (l.empty()) {
         throw std::runtime_error("empty screen layout configuration");
     }
 
-    subscribe_to_motion_events(XDefaultRootWindow(dsp.get()));
+    l.finalize();
+    return l;
+}
+
+void display::watch_screen_layout_file() {
+    layout_watch = file_descriptor(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!layout_watch.valid()) {
+        throw std::system_error(errno, std::system_category(), "failed to create inotify fd");
+    }
+
+    // the directory is watched, editors replace the file and it may not exist yet
+    auto dir = std::filesystem::path(opts.layout_file).parent_path();
+    if (inotify_add_watch(*layout_watch, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to watch " + dir.string());
+    }
+
+    ctx.get_el().add_fd(*layout_watch, std::bind(&display::handle_layout_watch, this, std::placeholders::_1));
 }
 
-void display::subscribe_to_motion_events(Window win) {
-    unsigned char mask_bytes[(XI_LASTEVENT + 7) / 8] = {0};
-    XISetMask(mask_bytes, XI_RawMotion);
+void display::handle_layout_watch(int) {
+    auto name = std::filesystem::path(opts.layout_file).filename().string();
+    bool changed = false;
+
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        auto len = ::read(*layout_watch, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                break;
+            }
+            throw std::system_error(errno, std::system_category(), "failed to read inotify fd");
+        }
+
+        for (auto p = buf; p < buf + len;) {
+            auto ev = reinterpret_cast<inotify_event const *>(p);
+            p += sizeof(inotify_event) + ev->len;
+            changed |= ev->len && name == ev->name;
+        }
+    }
+
+    if (changed) {
+        log.info(opts.layout_file + " changed, reloading the screen layout");
+        load_screen_layout();
 
-    XIEventMask evmasks[1];
-    evmasks[0].deviceid = XIAllDevices;
-    evmasks[0].mask_len = sizeof(mask_bytes);
-    evmasks[0].mask = mask_bytes;
+        // events read while waiting for the RandR replies sit in the queue, epoll does not report them
+        handle_events(xcb_get_file_descriptor(conn.get()));
+    }
+}
 
-    if (auto mask = XISelectEvents(dsp.get(), win, evmasks, 1); mask > 0) {
-        throw std::runtime_error("failed to select XI events");
+void display::load_screen_layout() {
+    // the layout file overrides RandR as long as it exists and parses, a broken file keeps the
+    // layout in use
+    if (!opts.layout_file.empty() && std::filesystem::exists(opts.layout_file)) {
+        try {
+            set_screen_layout(read_screen_layout_from_file(opts.layout_file));
+            layout_from_file = true;
+            return;
+        } catch (std::runtime_error const & e) {
+            log.err(opts.layout_file + ": " + e.what());
+            if (!screen_layout.empty()) {
+                log.warn("keeping the previous screen layout");
+                return;
+            }
+        }
     }
+
+    layout_from_file = false;
+    update_screen_layout();
 }
 
-void display::detect_screen_layout() {
-    int screens = XScreenCount(dsp.get());
-    log.info("display has " + std::to_string(screens) + " screens");
+void display::query_devices() {
+    auto cookie = xcb_input_xi_query_device(conn.get(), XCB_INPUT_DEVICE_ALL);
+    reply_t<xcb_input_xi_query_device_reply_t> reply { xcb_input_xi_query_device_reply(conn.get(), cookie, nullptr) };
+    if (!reply) {
+        throw std::runtime_error("failed to query XI devices");
+    }
+
+    relative_devices.clear();
+    raw_devices.clear();
+    attachments.clear();
+    std::vector<xcb_input_device_id_t> present;
+    bool attached = false;
+
+    // absolute devices (tablets, touchscreens) report positions in their raw events, not deltas
+    for (auto dev = xcb_input_xi_query_device_infos_iterator(reply.get()); dev.rem;
+        xcb_input_xi_device_info_next(&dev)) {
+
+        if (dev.data->type == XCB_INPUT_DEVICE_TYPE_MASTER_POINTER) {
+            present.push_back(dev.data->deviceid);
+        } else if (dev.data->type == XCB_INPUT_DEVICE_TYPE_SLAVE_POINTER) {
+            attachments.emplace_back(dev.data->deviceid, dev.data->attachment);
+        }
+
+        std::string name(xcb_input_xi_device_info_name(dev.data), xcb_input_xi_device_info_name_length(dev.data));
+        if (dev.data->type == XCB_INPUT_DEVICE_TYPE_SLAVE_POINTER
+            && std::find(opts.devices.begin(), opts.devices.end(), name) != opts.devices.end()) {
+            raw_devices.push_back(dev.data->deviceid);
+        }
+        if (dev.data->type == XCB_INPUT_DEVICE_TYPE_SLAVE_POINTER && dev.data->enabled && name == UINPUT_DEVICE_NAME) {
+            attached = true;
+        }
+
+        for (auto cls = xcb_input_xi_device_info_classes_iterator(dev.data); cls.rem;
+            xcb_input_device_class_next(&cls)) {
+
+            if (cls.data->type != XCB_INPUT_DEVICE_CLASS_TYPE_VALUATOR) {
+                continue;
+            }
+
+            auto v = reinterpret_cast<xcb_input_valuator_class_t const *>(cls.data);
+            if (v->number == 0 && v->mode == XCB_INPUT_VALUATOR_MODE_RELATIVE) {
+                relative_devices.push_back(dev.data->deviceid);
+            }
+        }
+    }
 
+    if (pointer && attached != pointer_attached) {
+        log.info(attached ? "uinput pointer attached" : "uinput pointer detached, warping instead");
+    }
+    pointer_attached = attached;
+
+    // removed masters take their state with them
+    std::erase_if(masters, [&](auto const & m) {
+        return std::find(present.begin(), present.end(), m.id) == present.end();
+    });
+
+    log.debug("found " + std::to_string(present.size()) + " master pointers, "
+        + std::to_string(relative_devices.size()) + " relative pointer devices");
+    if (!opts.devices.empty()) {
+        log.info("following raw motion of " + std::to_string(raw_devices.size()) + " of "
+            + std::to_string(opts.devices.size()) + " configured devices");
+    }
+}
+
+void display::handle_hierarchy(xcb_input_hierarchy_event_t const & he) {
+    auto changes = XCB_INPUT_HIERARCHY_MASK_MASTER_ADDED | XCB_INPUT_HIERARCHY_MASK_MASTER_REMOVED
+        | XCB_INPUT_HIERARCHY_MASK_SLAVE_ADDED | XCB_INPUT_HIERARCHY_MASK_SLAVE_REMOVED
+        | XCB_INPUT_HIERARCHY_MASK_SLAVE_ATTACHED | XCB_INPUT_HIERARCHY_MASK_SLAVE_DETACHED
+        | XCB_INPUT_HIERARCHY_MASK_DEVICE_ENABLED | XCB_INPUT_HIERARCHY_MASK_DEVICE_DISABLED;
+    if (!(he.flags & changes)) {
+        return;
+    }
+
+    log.debug("input devices changed");
+    query_devices();
+
+    // while hidden the selection is renewed once the pointer is back
+    if (!hidden) {
+        for (auto win : event_windows) {
+            xcb_discard_reply(conn.get(), subscribe_to_events(win).sequence);
+        }
+        xcb_flush(conn.get());
+    }
+}
+
+xcb_void_cookie_t display::subscribe_to_events(xcb_window_t win, bool enable) {
+    struct mask_t {
+        xcb_input_event_mask_t head;
+        uint32_t mask;
+    };
+    std::vector<mask_t> masks;
+
+    // a device listed twice would replace its first mask
+    auto select = [&](xcb_input_device_id_t device, uint32_t mask) {
+        auto m = std::find_if(masks.begin(), masks.end(), [&](auto const & m) { return m.head.deviceid == device; });
+        if (m == masks.end()) {
+            masks.push_back({ { device, 1 }, mask });
+        } else {
+            m->mask |= mask;
+        }
+    };
+
+    if (opts.barriers) {
+        // barrier events are delivered on the window the barrier belongs to, nothing arrives
+        // until the pointer pushes against an external edge
+        select(XCB_INPUT_DEVICE_ALL_MASTER,
+            XCB_INPUT_XI_EVENT_MASK_BARRIER_HIT | XCB_INPUT_XI_EVENT_MASK_BARRIER_LEAVE);
+    } else {
+        // raw motion is delivered no matter which window the pointer is over, but carries no position.
+        // motion on the root window carries the position, but only reaches us when no other client
+        // selected motion on the window below the pointer. with evdev the devices themselves tell
+        // about motion, the root motion only corrects the position. enter and leave on the roots
+        // tell which screen holds the pointer.
+        //
+        // the raw event of a slave is repeated for its master, only one of them is selected: the
+        // configured devices or the masters, all devices on servers before XI 2.1
+        if (!opts.evdev && !opts.devices.empty()) {
+            for (auto device : raw_devices) {
+                select(device, XCB_INPUT_XI_EVENT_MASK_RAW_MOTION);
+            }
+        } else if (!opts.evdev) {
+            select(master_raw ? XCB_INPUT_DEVICE_ALL_MASTER : XCB_INPUT_DEVICE_ALL, XCB_INPUT_XI_EVENT_MASK_RAW_MOTION);
+        }
+        select(XCB_INPUT_DEVICE_ALL_MASTER, XCB_INPUT_XI_EVENT_MASK_MOTION
+            | XCB_INPUT_XI_EVENT_MASK_ENTER | XCB_INPUT_XI_EVENT_MASK_LEAVE);
+    }
+
+    if (!enable) {
+        // an empty mask removes the selection of the device
+        for (auto & m : masks) {
+            m.mask = 0;
+        }
+    }
+
+    // hot-plugged devices are picked up while hidden as well, so is the uinput device created again
+    if (track_devices || pointer) {
+        select(XCB_INPUT_DEVICE_ALL, XCB_INPUT_XI_EVENT_MASK_HIERARCHY);
+    }
+
+    return xcb_input_xi_select_events_checked(conn.get(), win, masks.size(), &masks[0].head);
+}
+
+void display::create_barriers() {
+    for (auto const & b : barriers) {
+        xcb_xfixes_delete_pointer_barrier(conn.get(), b.id);
+    }
+    barriers.clear();
+
+    auto const & monitors = screen_layout.get_monitors();
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        auto const & m = monitors[i];
+
+        // the line the pointer stops at when pushed outwards, the barrier lets it pass inwards only
+        struct { uint8_t border; bool vertical; int line; uint32_t directions; } edges[] = {
+            { border_t::LEFT, true, m.x, XCB_XFIXES_BARRIER_DIRECTIONS_POSITIVE_X },
+            { border_t::TOP, false, m.y, XCB_XFIXES_BARRIER_DIRECTIONS_POSITIVE_Y },
+            { border_t::RIGHT, true, m.x + m.w, XCB_XFIXES_BARRIER_DIRECTIONS_NEGATIVE_X },
+            { border_t::BOTTOM, false, m.y + m.h, XCB_XFIXES_BARRIER_DIRECTIONS_NEGATIVE_Y },
+        };
+
+        for (auto const & e : edges) {
+            for (auto const & s : screen_layout.external(i, e.border)) {
+                auto id = xcb_generate_id(conn.get());
+                if (e.vertical) {
+                    xcb_xfixes_create_pointer_barrier(conn.get(), id, m.root, e.line, s.from, e.line, s.to - 1,
+                        e.directions, 0, nullptr);
+                } else {
+                    xcb_xfixes_create_pointer_barrier(conn.get(), id, m.root, s.from, e.line, s.to - 1, e.line,
+                        e.directions, 0, nullptr);
+                }
+                barriers.push_back({ id, i, e.border, std::nullopt });
+            }
+        }
+    }
+
+    log.debug("created " + std::to_string(barriers.size()) + " pointer barriers");
+    xcb_flush(conn.get());
+}
+
+layout display::detect_screen_layout() {
+    if (!rr_event_base) {
+        throw std::runtime_error("XRandR 1.5 not supported");
+    }
+
+    log.info("display has " + std::to_string(roots.size()) + " screens");
+
+    // the queries for all screens are in flight before the first reply is awaited
+    std::vector<xcb_randr_get_monitors_cookie_t> cookies;
+    for (auto root : roots) {
+        cookies.push_back(xcb_randr_get_monitors(conn.get(), root, 1));
+    }
+
+    layout l;
     size_t id = 0;
-    for (auto s = 0; s < screens; ++s) {
-        auto screen = XScreenOfDisplay(dsp.get(), s);
-        if (!screen) {
-            throw std::runtime_error("failed to get screen for display");
+    for (size_t s = 0; s < roots.size(); ++s) {
+        reply_t<xcb_randr_get_monitors_reply_t> reply {
+            xcb_randr_get_monitors_reply(conn.get(), cookies[s], nullptr) };
+        if (!reply) {
+            throw std::runtime_error("failed to get monitors of screen " + std::to_string(s));
         }
 
-        auto root = XRootWindowOfScreen(screen);
+        auto m = 0;
+        for (auto it = xcb_randr_get_monitors_monitors_iterator(reply.get()); it.rem;
+            xcb_randr_monitor_info_next(&it), ++m) {
 
-        int monitors = 0;
-        XRRMonitorInfo * moninfo = XRRGetMonitors(dsp.get(), root, 1, &monitors);
-        for (auto m = 0; m < monitors; ++m) {
-            auto & mi = moninfo[m];
+            auto const & mi = *it.data;
             std::stringstream ss;
             ss << "monitor " << m << " of screen " << s << ": " << mi.x << " " << mi.y << " "
                << mi.width << "x" << mi.height;
             log.info(ss.str());
 
-            add_monitor(id, mi.x, mi.y, mi.width, mi.height, root);
+            l.add_monitor(id, mi.x, mi.y, mi.width, mi.height, roots[s], BORDER_WIDTH);
             ++id;
         }
+    }
 
-        log.info("display size: " + std::to_string(width) + "x" + std::to_string(height));
-        subscribe_to_motion_events(root);
+    l.finalize();
+    log.info("display size: " + std::to_string(l.width()) + "x" + std::to_string(l.height()));
+    return l;
+}
+
+void display::update_screen_layout() {
+    layout_changed = false;
+
+    // a hotplug may report no monitors for a moment. without a previous layout there is nothing to
+    // look positions up in, starting over retries until monitors show up.
+    auto l = detect_screen_layout();
+    if (l.empty()) {
+        if (screen_layout.empty()) {
+            throw std::runtime_error("no monitors found");
+        }
+        log.warn("no monitors found, keeping the previous screen layout");
+        return;
     }
+
+    set_screen_layout(std::move(l));
 }
 
-void display::add_monitor(int mon, int x, int y, int w, int h, Window root) {
-    border_rects.emplace_back(x, y, BORDER_WIDTH, h, mon, border_t::LEFT, root);
-    border_rects.emplace_back(x, y, w, BORDER_WIDTH, mon, border_t::TOP, root);
-    border_rects.emplace_back(x + w - BORDER_WIDTH, y, BORDER_WIDTH, h, mon, border_t::RIGHT, root);
-    border_rects.emplace_back(x, y + h - BORDER_WIDTH, w, BORDER_WIDTH, mon, border_t::BOTTOM, root);
+void display::set_screen_layout(layout && l) {
+    screen_layout = std::move(l);
 
-    monitors.emplace_back(monitor_t { .id = mon, .x = x, .y = y, .w = w, .h = h, .root = root });
-    width = std::max(x + w, width);
-    height = std::max(y + h, height);
+    if (opts.barriers) {
+        create_barriers();
+    }
+    for (auto & m : masters) {
+        if (m.predict) {
+            m.predict->reset();
+        }
+        m.edges.rearm();
+        m.last_pos.reset();
+        m.budget = 0;
+    }
+    if (pointer && pointer->resize(screen_layout.width(), screen_layout.height())) {
+        log.info("uinput pointer created again, warping until the server attached it");
+        pointer_attached = false;
+    }
 }
 
 void display::set_mouse_pos(mouse_pos_t const & mp) {
-    if (last_pos && get_mon_for_pos(*last_pos) == monitors[mp.screen]
+    auto const & monitors = screen_layout.get_monitors();
+    if (mp.screen >= monitors.size()) {
+        log.warn("position for unknown screen " + std::to_string(mp.screen));
+        return;
+    }
+
+    // the device answered, whatever border comes next is news to it
+    for (auto & m : masters) {
+        m.edges.rearm();
+    }
+
+    auto & p = master(active);
+    if (p.last_pos && get_mon_for_pos(*p.last_pos) == monitors[mp.screen]
         && mp.border <= border_t::RIGHT && !hidden) {
         return;
     }
@@ -151,8 +603,17 @@ void display::set_mouse_pos(mouse_pos_t const & mp) {
        << " pos:" << mp.pos;
     log.debug(ss.str());
 
+    if ((mp.border == border_t::HIDE) != hidden) {
+        set_hidden(mp.border == border_t::HIDE);
+    }
+
+    // the pointer comes to this PC, the user expects to see the screens
+    if (idle && mp.border != border_t::HIDE) {
+        xcb_force_screen_saver(conn.get(), XCB_SCREEN_SAVER_RESET);
+        set_idle(false);
+    }
+
     int x, y;
-    hidden = false;
     switch (mp.border) {
         case border_t::TOP:
             x = monitors[mp.screen].x + monitors[mp.screen].w * mp.pos / RESOLUTION;
@@ -172,164 +633,681 @@ void display::set_mouse_pos(mouse_pos_t const & mp) {
             break;
         case border_t::HIDE:
             log.debug("hiding cursor");
-            // we position the pointer in the left bottom border, there is still 1 pixel visible
-            // maybe we could really hide it by overriding the cursor bitmap
+            // the hidden pointer is parked in the left bottom corner
             x = monitors[mp.screen].x;
-            y = monitors[mp.screen].y + height;
-            hidden = true;
+            y = monitors[mp.screen].y + screen_layout.height();
             break;
         default:
             log.debug("centering cursor");
             x = monitors[mp.screen].x + monitors[mp.screen].w / 2;
             y = monitors[mp.screen].y + monitors[mp.screen].h / 2;
     }
-    XWarpPointer(dsp.get(), None, monitors[mp.screen].root, 0, 0, 0, 0, x, y);
-    last_pos = { x, y, monitors[mp.screen].root };
-    XFlush(dsp.get());
+    // an absolute device only reaches the screen and the master it is attached to. its motion takes
+    // the input path and isn't tied to a request, it is recognized by the position.
+    // a device created again after a layout change is warped around until the server attached it
+    if (pointer && pointer_attached && monitors[mp.screen].root == default_root && p.id == CORE_POINTER) {
+        p.warp_step = pointer->move(x, y);
+        p.warped = true;
+    } else {
+        xcb_input_xi_warp_pointer(conn.get(), XCB_NONE, monitors[mp.screen].root, 0, 0, 0, 0,
+            x * 65536, y * 65536, p.id);
+
+        // events carry the sequence number of the last request the server processed, the warp's
+        // number stays on everything until the next request. a cheap request right after the warp
+        // marks where the events caused by input start again.
+        warp = xcb_get_input_focus(conn.get()).sequence;
+        xcb_discard_reply(conn.get(), *warp);
+    }
+    p.last_pos = { x, y, monitors[mp.screen].root };
+    p.budget = 0;
+    xcb_flush(conn.get());
+}
+
+void display::set_hidden(bool hide) {
+    // while another PC is the target the server has nothing to tell us: the cursor is hidden and the
+    // pointer events are deselected until the device hands the pointer back
+    hidden = hide;
+    for (auto win : event_windows) {
+        xcb_discard_reply(conn.get(), subscribe_to_events(win, !hide).sequence);
+    }
+
+    for (auto root : roots) {
+        if (hide) {
+            xcb_xfixes_hide_cursor(conn.get(), root);
+        } else {
+            xcb_xfixes_show_cursor(conn.get(), root);
+        }
+    }
+
+    for (auto & b : barriers) {
+        b.event.reset();
+    }
+}
+
+void display::set_idle(bool inactive) {
+    if (inactive == idle) {
+        return;
+    }
+    idle = inactive;
+
+    log.info(idle ? "session idle, slowing down" : "session active");
+    ctx.set_idle(*this, idle);
+
+    // input ended the idle state, the monitors go dark a full timeout from now. the server is asked
+    // again when the timer expires, the resume path doesn't wait for replies.
+    if (!idle && dpms) {
+        arm_idle_timer(dpms_timeout.value_or(1));
+    }
+}
+
+void display::check_idle() {
+    // notifications only report changes, the screensaver may already be active
+    if (ss_event_base) {
+        auto cookie = xcb_screensaver_query_info(conn.get(), default_root);
+        reply_t<xcb_screensaver_query_info_reply_t> info {
+            xcb_screensaver_query_info_reply(conn.get(), cookie, nullptr) };
+        if (info) {
+            set_idle(info->state == XCB_SCREENSAVER_STATE_ON || info->state == XCB_SCREENSAVER_STATE_CYCLE);
+        } else {
+            log.warn("failed to query screensaver state");
+        }
+    }
+
+    // the end of the screensaver checks DPMS again
+    if (dpms && !idle) {
+        check_dpms();
+    }
+
+    // events read while waiting for the replies sit in the queue, epoll does not report them
+    handle_events(xcb_get_file_descriptor(conn.get()));
+}
+
+void display::check_dpms() {
+    auto info_cookie = xcb_dpms_info(conn.get());
+    auto timeouts_cookie = xcb_dpms_get_timeouts(conn.get());
+    std::optional<xcb_screensaver_query_info_cookie_t> ss_cookie;
+    if (ss_event_base) {
+        ss_cookie = xcb_screensaver_query_info(conn.get(), default_root);
+    }
+
+    reply_t<xcb_dpms_info_reply_t> info { xcb_dpms_info_reply(conn.get(), info_cookie, nullptr) };
+    reply_t<xcb_dpms_get_timeouts_reply_t> timeouts {
+        xcb_dpms_get_timeouts_reply(conn.get(), timeouts_cookie, nullptr) };
+    reply_t<xcb_screensaver_query_info_reply_t> ss_info {
+        ss_cookie ? xcb_screensaver_query_info_reply(conn.get(), *ss_cookie, nullptr) : nullptr };
+    if (!info || !timeouts) {
+        log.warn("failed to query DPMS state");
+        return;
+    }
+
+    // powered down monitors come back with input, which ends the idle state
+    if (info->state && info->power_level != XCB_DPMS_DPMS_MODE_ON) {
+        set_idle(true);
+        return;
+    }
+
+    // the monitors go dark with the shortest timeout that is set, counted from the last input
+    long timeout = 0;
+    for (long t : { timeouts->standby_timeout, timeouts->suspend_timeout, timeouts->off_timeout }) {
+        if (t && (!timeout || t < timeout)) {
+            timeout = t;
+        }
+    }
+    dpms_timeout = info->state ? timeout * 1000 : 0;
+
+    if (*dpms_timeout) {
+        arm_idle_timer(std::max(*dpms_timeout - (ss_info ? ss_info->ms_since_user_input : 0), 1000L));
+    } else {
+        arm_idle_timer(0);
+    }
+}
+
+void display::arm_idle_timer(long ms) {
+    // 0 disarms the timer
+    struct itimerspec ts = {};
+    ts.it_value.tv_sec = ms / 1000;
+    ts.it_value.tv_nsec = ms % 1000 * 1000 * 1000L;
+
+    if (timerfd_settime(*idle_timer, 0, &ts, NULL) < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to arm idle timer");
+    }
+}
+
+void display::handle_idle_timer(int) {
+    uint64_t count;
+    if (__builtin_expect(::read(*idle_timer, &count, sizeof(count)), sizeof(count)) < 0) {
+        if (errno != EAGAIN) {
+            throw std::system_error(errno, std::system_category(), "failed to read idle timer");
+        }
+    }
+    check_dpms();
+
+    // events read while waiting for the replies sit in the queue, epoll does not report them
+    handle_events(xcb_get_file_descriptor(conn.get()));
 }
 
 void display::handle_events(int) {
-    XEvent ev;
-    while (XPending(dsp.get())) {
-        XNextEvent(dsp.get(), &ev);
+    std::optional<xcb_input_device_id_t> raw_motion;
+    std::optional<motion_t> motion;
 
-        if (ev.xcookie.type == GenericEvent && ev.xcookie.extension == xi_opcode) {
-            if (!XGetEventData(dsp.get(), &ev.xcookie)) {
-                log.warn("failed to get X event data");
-                continue;
+    // the first poll reads what the socket has, the rest of the batch comes from the queue without
+    // further reads. a pointer query reply read together with the events is picked up once the
+    // queue ran empty.
+    reply_t<xcb_generic_event_t> ev { xcb_poll_for_event(conn.get()) };
+    do {
+        while (ev || handle_pointer_reply(motion)) {
+            if (ev) {
+                handle_event(ev.get(), motion, raw_motion);
             }
+            ev.reset(xcb_poll_for_queued_event(conn.get()));
+        }
 
-            if (ev.xcookie.evtype != XI_RawMotion || hidden) {
-                XFreeEventData(dsp.get(), &ev.xcookie);
-                continue;
-            }
-            XFreeEventData(dsp.get(), &ev.xcookie);
+        if (auto error = xcb_connection_has_error(conn.get())) {
+            throw std::runtime_error("connection to the X server failed, error: " + std::to_string(error));
+        }
 
-            Window root, child;
-            int root_x, root_y;
-            int x, y;
-            unsigned int mask;
+        if (motion) {
+            handle_pointer(*motion);
+            motion.reset();
+        }
 
-            for (auto & m : monitors) {
-                if (XQueryPointer(dsp.get(), m.root, &root, &child, &root_x, &root_y,
-                    &x, &y, &mask)) {
+        if (layout_changed) {
+            update_screen_layout();
+        }
 
-                    break;
-                }
-            }
+        // polling for a reply and waiting for the RandR replies read further events into the queue,
+        // epoll only reports the socket and never sees them
+        ev.reset(xcb_poll_for_queued_event(conn.get()));
+    } while (ev);
 
-            log.debug("pointer: " + std::to_string(root_x) + "/" + std::to_string(root_y));
+    // the pointer moved over a window that swallowed the motion event, ask for the position without
+    // waiting for the reply
+    if (raw_motion) {
+        query_pointer(*raw_motion);
+    }
+}
 
-            if (!last_pos.has_value()) {
-                last_pos = { root_x, root_y, root };
-            }
+void display::handle_event(xcb_generic_event_t const * ev, std::optional<motion_t> & motion,
+    std::optional<xcb_input_device_id_t> & raw_motion) {
+    auto type = ev->response_type & ~0x80;
 
-            if (mask & (Button1Mask | Button2Mask | Button3Mask | Button4Mask | Button5Mask)) {
-                log.debug("mouse button pressed, skipping border detection");
-                last_pos = { root_x, root_y, root };
-                continue;
-            }
+    if (type == 0) {
+        auto error = reinterpret_cast<xcb_generic_error_t const *>(ev);
+        log.warn("X error " + std::to_string(error->error_code) + " for request "
+            + std::to_string(error->major_code));
+        return;
+    }
 
-            auto const & m_last = get_mon_for_pos(*last_pos);
-            auto const & m_cur = get_mon_for_pos({root_x, root_y, root});
-            auto diff_x = std::abs(root_x - last_pos->x);
-            auto diff_y = std::abs(root_y - last_pos->y);
-            uint16_t pos = 0;
-            border_t border;
-
-            // we need to check if we crossed a border since last pointer update
-            if (root != last_pos->root) {
-                if (diff_x < diff_y) { // top/bottom
-                    pos = RESOLUTION * (last_pos->x - m_last.x) / m_last.w;
-                    if (root_y < m_cur.h / 2) { // top
-                        border = border_t::TOP;
-                    } else { //bottom
-                        border =  border_t::BOTTOM;
-                    }
-                } else { // left/right
-                    pos = RESOLUTION * (last_pos->y - m_last.y) / m_last.h;
-                    if (root_x < m_cur.w / 2) { // right
-                        border = border_t::RIGHT;
-                    } else { // left
-                        border = border_t::LEFT;
-                    }
-                }
+    if (rr_event_base && (type == rr_event_base + XCB_RANDR_SCREEN_CHANGE_NOTIFY
+        || type == rr_event_base + XCB_RANDR_NOTIFY)) {
 
-                log.debug("different root window, left at border: " + std::to_string(border));
-
-                ctx.mouse_at_border({
-                    .screen = static_cast<uint8_t>(m_last.id),
-                    .border = border,
-                    .pos = pos
-                });
-            } else if (m_last != m_cur && (diff_x >= 1 || diff_y >= 1)) {
-                if (m_cur.x == m_last.x) {
-                    log.debug("mons are above each other: "
-                              + std::to_string(m_cur.y) + "+" + std::to_string(m_cur.h) + " | "
-                              + std::to_string(m_last.y) + "+" + std::to_string(m_last.h));
-
-                    pos = RESOLUTION * (root_x - m_cur.x) / m_cur.w;
-                    border = m_cur.y + m_cur.h == m_last.y ? border_t::TOP : border_t::BOTTOM;
-                } else {
-                    log.debug("mons are next to each other: "
-                              + std::to_string(m_cur.x) + "+" + std::to_string(m_cur.w) + " | "
-                              + std::to_string(m_last.x) + "+" + std::to_string(m_last.w));
+        // a single change comes with a burst of notifications, the layout is rebuilt once
+        // before the next pointer event is evaluated. a layout file overrides RandR.
+        layout_changed = !layout_from_file;
+        return;
+    }
 
-                    border = m_cur.x + m_cur.w == m_last.x ? border_t::LEFT : border_t::RIGHT;
-                    pos = RESOLUTION * (root_y - m_cur.y) / m_cur.h;
-                }
-                log.debug("border: " + std::to_string(border));
-
-                ctx.mouse_at_border({
-                    .screen = static_cast<uint8_t>(m_last.id),
-                    .border = border,
-                    .pos = pos
-                });
-            } else {
-                for (auto & b : border_rects) {
-                    if (b.inside(root_x, root_y) && b.root == root) {
-                        switch (b.border) {
-                            case border_t::TOP:
-                            case border_t::BOTTOM:
-                                pos = RESOLUTION * (root_x - b.x) / b.w;
-                                break;
-                            case border_t::LEFT:
-                            case border_t::RIGHT:
-                                pos = RESOLUTION * (root_y - b.y) / b.h;
-                                break;
-                            default:
-                                throw std::runtime_error("invalid border");
-                        }
-
-                        log.debug("pointer at border " + std::to_string(b.border) + " of screen "
-                            + std::to_string(b.screen));
-
-                        ctx.mouse_at_border({
-                            .screen = static_cast<uint8_t>(b.screen),
-                            .border = b.border,
-                            .pos = pos
-                        });
-
-                        break;
-                    }
-                }
-            }
-            last_pos = { root_x, root_y, root };
+    if (ss_event_base && type == ss_event_base + XCB_SCREENSAVER_NOTIFY) {
+        // the server blanked the screens or a locker took over, input ends it
+        auto state = reinterpret_cast<xcb_screensaver_notify_event_t const *>(ev)->state;
+        set_idle(state == XCB_SCREENSAVER_STATE_ON || state == XCB_SCREENSAVER_STATE_CYCLE);
+        return;
+    }
+
+    if (layout_changed) {
+        if (motion) {
+            handle_pointer(*motion);
+            motion.reset();
+        }
+        update_screen_layout();
+    }
+
+    auto ge = reinterpret_cast<xcb_ge_generic_event_t const *>(ev);
+    if (type != XCB_GE_GENERIC || ge->extension != xi_opcode) {
+        return;
+    }
+
+    if (ge->event_type == XCB_INPUT_HIERARCHY) {
+        handle_hierarchy(*reinterpret_cast<xcb_input_hierarchy_event_t const *>(ev));
+        return;
+    }
+
+    if (hidden) {
+        return;
+    }
+
+    // input is the first thing to arrive when the user is back, nothing arrives while idle
+    if (idle) {
+        set_idle(false);
+    }
+
+    // events from before the marker request after the warp report the position before the warp or
+    // the warp itself, raw events stay physical motion
+    bool own = warp && before(ge->full_sequence, *warp);
+    if (warp && !own) {
+        warp.reset();
+    }
+
+    if (ge->event_type == XCB_INPUT_RAW_MOTION) {
+        auto const & re = *reinterpret_cast<xcb_input_raw_motion_event_t const *>(ev);
+        // selected devices are slaves, the position belongs to their master
+        auto slave = std::find_if(attachments.begin(), attachments.end(), [&](auto const & a) {
+            return a.first == re.deviceid;
+        });
+        auto & p = master(slave == attachments.end() ? re.deviceid : slave->second);
+        raw_motion = p.id;
+        if (p.predict) {
+            predict_border(p, re, motion);
+        }
+        return;
+    }
+
+    if (ge->event_type == XCB_INPUT_ENTER || ge->event_type == XCB_INPUT_LEAVE) {
+        handle_crossing(*reinterpret_cast<xcb_input_enter_event_t const *>(ev), motion, own);
+        return;
+    }
+
+    if (ge->event_type == XCB_INPUT_BARRIER_HIT || ge->event_type == XCB_INPUT_BARRIER_LEAVE) {
+        handle_barrier(*reinterpret_cast<xcb_input_barrier_hit_event_t const *>(ev));
+        return;
+    }
+
+    if (ge->event_type != XCB_INPUT_MOTION || own) {
+        return;
+    }
+
+    auto me = reinterpret_cast<xcb_input_motion_event_t const *>(ev);
+
+    // the motion event for a raw event follows it, no need to ask the server for the position
+    if (raw_motion == me->deviceid) {
+        raw_motion.reset();
+    }
+
+    motion_t m { .pos = { me->root_x >> 16, me->root_y >> 16, me->root }, .device = me->deviceid };
+    if (xcb_input_button_press_button_mask_length(me) > 0) {
+        // buttons 1 to 5
+        m.button_pressed = xcb_input_button_press_button_mask(me)[0] & 0x3e;
+    }
+
+    coalesce_motion(motion, m);
+}
+
+void display::coalesce_motion(std::optional<motion_t> & pending, motion_t const & next) {
+    // only the newest position of a batch is evaluated, unless the skipped one is needed to detect
+    // a border: it touched a border strip, the path left its monitor or a button changed
+    if (pending) {
+        bool flush = pending->device != next.device
+            || pending->pos.root != next.pos.root
+            || pending->button_pressed != next.button_pressed;
+
+        // positions within the budget of the master stay on its monitor and away from the borders,
+        // only the others are looked up
+        auto const & p = master(pending->device);
+        auto within = [&](pos_t const & pos) {
+            return p.last_pos && pos.root == p.last_pos->root
+                && std::max(std::abs(pos.x - p.last_pos->x), std::abs(pos.y - p.last_pos->y)) < p.budget;
+        };
+        if (!flush && !(within(pending->pos) && within(next.pos))) {
+            auto const & m = get_mon_for_pos(pending->pos);
+            flush = near_border(pending->pos, m) || m != get_mon_for_pos(next.pos);
+        }
+
+        if (flush) {
+            handle_pointer(*pending);
+        }
+    }
+
+    pending = next;
+}
+
+bool display::near_border(pos_t const & pos, monitor_t const & m) const {
+    return pos.x <= m.x + BORDER_WIDTH || pos.x >= m.x + m.w - BORDER_WIDTH
+        || pos.y <= m.y + BORDER_WIDTH || pos.y >= m.y + m.h - BORDER_WIDTH;
+}
+
+void display::query_pointer(xcb_input_device_id_t device) {
+    if (pointer_query) {
+        query_again = device;
+        return;
+    }
+
+    // enter events on the roots tell which screen holds the pointer, only that one is asked
+    auto cookie = xcb_input_xi_query_pointer(conn.get(), master(device).root, device);
+    pointer_query = { cookie.sequence, device };
+    xcb_flush(conn.get());
+}
+
+bool display::handle_pointer_reply(std::optional<motion_t> & motion) {
+    if (!pointer_query) {
+        return false;
+    }
+
+    void * reply_data = nullptr;
+    xcb_generic_error_t * error_data = nullptr;
+    if (!xcb_poll_for_reply(conn.get(), pointer_query->sequence, &reply_data, &error_data)) {
+        return false;
+    }
+    auto query = *pointer_query;
+    pointer_query.reset();
+
+    reply_t<xcb_input_xi_query_pointer_reply_t> reply { static_cast<xcb_input_xi_query_pointer_reply_t *>(reply_data) };
+    reply_t<xcb_generic_error_t> error { error_data };
+    if (error) {
+        log.warn("failed to query pointer, error: " + std::to_string(error->error_code));
+    } else if (warp && before(query.sequence, *warp)) {
+        // asked before the warp, the position is outdated
+    } else if (reply && !hidden) {
+        master(query.device).root = reply->root;
+        bool pressed = xcb_input_xi_query_pointer_buttons_length(reply.get()) > 0
+            && (xcb_input_xi_query_pointer_buttons(reply.get())[0] & 0x3e);
+        coalesce_motion(motion, {
+            .pos = { reply->root_x >> 16, reply->root_y >> 16, reply->root },
+            .button_pressed = pressed,
+            .device = query.device
+        });
+    }
+
+    if (query_again) {
+        auto device = *query_again;
+        query_again.reset();
+        query_pointer(device);
+    }
+
+    return true;
+}
+
+void display::handle_relative_motion(int dx, int dy, bool button_pressed) {
+    // evdev doesn't tell which master a device belongs to, its motion moves the one in use
+    auto & p = master(active);
+    auto & last_pos = p.last_pos;
+    if (hidden || !last_pos) {
+        return;
+    }
+
+    // the deltas are integrated without the server's pointer acceleration and clamped to the
+    // monitors like the server clamps the pointer, the next motion from the server corrects the
+    // position
+    auto x = last_pos->x + dx;
+    auto y = last_pos->y + dy;
+    auto const & m = screen_layout.monitor_at(x, y, last_pos->root);
+    pos_t pos {
+        std::clamp(x, m.x, m.x + m.w - 1),
+        std::clamp(y, m.y, m.y + m.h - 1),
+        last_pos->root
+    };
+
+    if (pos != *last_pos) {
+        handle_pointer({ .pos = pos, .button_pressed = button_pressed, .device = p.id });
+    }
+}
+
+void display::predict_border(master_t & p, xcb_input_raw_motion_event_t const & re,
+    std::optional<motion_t> const & pending) {
+    // the device the motion comes from, the event may be the master's copy
+    if (std::find(relative_devices.begin(), relative_devices.end(), re.sourceid) == relative_devices.end()) {
+        return;
+    }
+
+    // the newest known position, the motion of this delta isn't there yet
+    bool own = pending && pending->device == p.id;
+    auto cur = own ? std::optional<pos_t>(pending->pos) : p.last_pos;
+    if (!cur || (own ? pending->button_pressed : p.last_pressed)) {
+        return;
+    }
+
+    double delta[2] = { 0, 0 };
+    auto mask = xcb_input_raw_button_press_valuator_mask(&re);
+    auto values = xcb_input_raw_button_press_axisvalues(&re);
+    size_t idx = 0;
+    for (auto axis = 0; axis < 2 && xcb_input_raw_button_press_valuator_mask_length(&re) > 0; ++axis) {
+        if (mask[0] & (1u << axis)) {
+            delta[axis] = values[idx].integral + values[idx].frac / 4294967296.0;
+            ++idx;
         }
     }
+
+    auto mp = p.predict->push(screen_layout, cur->x, cur->y, cur->root, delta[0], delta[1]);
+    if (mp && p.edges.fire(screen_layout, get_mon_for_pos(*cur), mp->border)) {
+        active = p.id;
+        log.debug("pointer pushing into border " + std::to_string(mp->border) + " of screen "
+            + std::to_string(mp->screen));
+        ctx.mouse_at_border(*this, *mp);
+    }
+}
+
+void display::handle_barrier(xcb_input_barrier_hit_event_t const & be) {
+    auto b = std::find_if(barriers.begin(), barriers.end(), [&](auto const & b) { return b.id == be.barrier; });
+    if (b == barriers.end()) {
+        return;
+    }
+
+    if (be.event_type == XCB_INPUT_BARRIER_LEAVE) {
+        b->event.reset();
+        return;
+    }
+
+    // a push against the edge is a sequence of hits with the same event id, the border is
+    // triggered once per push. a grabbed pointer is dragging something, just like a pressed button.
+    if (b->event == be.eventid || (be.flags & XCB_INPUT_BARRIER_FLAGS_DEVICE_IS_GRABBED)) {
+        return;
+    }
+    b->event = be.eventid;
+
+    auto const & m = screen_layout.get_monitors()[b->monitor];
+    pos_t cur { be.root_x >> 16, be.root_y >> 16, be.root };
+    uint16_t pos = (b->border == border_t::TOP || b->border == border_t::BOTTOM)
+        ? RESOLUTION * (cur.x - m.x) / m.w
+        : RESOLUTION * (cur.y - m.y) / m.h;
+
+    log.debug("pointer hit barrier at border " + std::to_string(b->border) + " of screen " + std::to_string(m.id));
+
+    auto & p = master(be.deviceid);
+    p.last_pos = cur;
+    p.budget = 0;
+    active = be.deviceid;
+    ctx.mouse_at_border(*this, {
+        .screen = static_cast<uint8_t>(m.id),
+        .border = b->border,
+        .pos = pos
+    });
 }
 
-display::monitor_t const & display::get_mon_for_pos(pos_t const & pos) const {
-    for (auto const & m : monitors) {
-        if ((pos.root == m.root || pos.root == 0)
-            && pos.x >= m.x
-            && pos.x <= m.x + m.w
-            && pos.y >= m.y
-            && pos.y <= m.y + m.h) {
+void display::handle_crossing(xcb_input_enter_event_t const & ce, std::optional<motion_t> & pending, bool own) {
+    // only the pointer changing screens counts, not moving between the root and its children or
+    // grabs
+    if (ce.mode != XCB_INPUT_NOTIFY_MODE_NORMAL
+        || (ce.detail != XCB_INPUT_NOTIFY_DETAIL_NONLINEAR && ce.detail != XCB_INPUT_NOTIFY_DETAIL_NONLINEAR_VIRTUAL)) {
+        return;
+    }
+
+    auto & p = master(ce.deviceid);
+    if (ce.event_type == XCB_INPUT_ENTER) {
+        p.root = ce.event;
+        return;
+    }
 
-            return m;
+    // our warp moved the pointer to another screen, the device already knows
+    if (own) {
+        return;
+    }
+
+    // the positions on the screen being left come first, the last one is where it was left
+    if (pending) {
+        handle_pointer(*pending);
+        pending.reset();
+    }
+
+    if (p.last_pos && p.last_pos->root == ce.event && !p.last_pressed) {
+        auto mp = exit_at(*p.last_pos);
+        log.debug("pointer " + std::to_string(p.id) + " left the screen at border " + std::to_string(mp.border)
+            + " of screen " + std::to_string(mp.screen));
+        active = p.id;
+        ctx.mouse_at_border(*this, mp);
+    }
+
+    // the first position on the new screen starts over
+    p.last_pos.reset();
+    p.budget = 0;
+}
+
+mouse_pos_t display::exit_at(pos_t const & p) const {
+    // the pointer leaves through the external border of its monitor it was closest to
+    auto const & m = get_mon_for_pos(p);
+    struct { uint8_t border; int distance; int along; } borders[] = {
+        { border_t::LEFT, p.x - m.x, p.y },
+        { border_t::RIGHT, m.x + m.w - 1 - p.x, p.y },
+        { border_t::TOP, p.y - m.y, p.x },
+        { border_t::BOTTOM, m.y + m.h - 1 - p.y, p.x },
+    };
+
+    auto best = &borders[0];
+    bool best_external = false;
+    for (auto & b : borders) {
+        bool external = screen_layout.is_external(m, b.border, b.along);
+        if ((external && !best_external) || (external == best_external && b.distance < best->distance)) {
+            best = &b;
+            best_external = external;
+        }
+    }
+
+    uint16_t pos = best->border == border_t::TOP || best->border == border_t::BOTTOM
+        ? RESOLUTION * (p.x - m.x) / m.w
+        : RESOLUTION * (p.y - m.y) / m.h;
+
+    return { .screen = static_cast<uint8_t>(m.id), .border = best->border, .pos = pos };
+}
+
+void display::handle_pointer(motion_t const & motion) {
+    auto & p = master(motion.device);
+    auto const & cur = motion.pos;
+    auto button_pressed = motion.button_pressed;
+    auto root_x = cur.x;
+    auto root_y = cur.y;
+    auto root = cur.root;
+
+    // the uinput device reports the position we just set, a repeated placement comes with a step
+    // one unit aside first
+    if (p.warped && p.last_pos && root == p.last_pos->root && root_y == p.last_pos->y) {
+        if (root_x == p.last_pos->x) {
+            p.warped = false;
+            p.warp_step.reset();
+            return;
+        }
+        if (p.warp_step == root_x) {
+            p.warp_step.reset();
+            return;
         }
     }
+    p.warped = false;
+    p.warp_step.reset();
+
+    if (!p.last_pos.has_value()) {
+        p.last_pos = { root_x, root_y, root };
+        p.budget = 0;
+    }
+
+    // nothing can be hit or crossed before the motion since the last evaluation covered the distance
+    // to the closest side of the monitor. the steps add up, so positions in between are covered too.
+    auto step = std::max(std::abs(root_x - p.last_pos->x), std::abs(root_y - p.last_pos->y));
+    p.budget -= step;
+    if (p.budget > 0 && root == p.last_pos->root && button_pressed == p.last_pressed) {
+        p.last_pos = cur;
+        return;
+    }
+
+    log.debug("pointer " + std::to_string(p.id) + ": " + std::to_string(root_x) + "/" + std::to_string(root_y));
+    p.last_pressed = button_pressed;
+
+    if (button_pressed) {
+        log.debug("mouse button pressed, skipping border detection");
+        p.last_pos = { root_x, root_y, root };
+        p.budget = 0;
+        return;
+    }
+
+    p.edges.update(screen_layout, root_x, root_y, root);
+
+    auto const & m_last = get_mon_for_pos(*p.last_pos);
+    auto const & m_cur = get_mon_for_pos({root_x, root_y, root});
+    auto diff_x = std::abs(root_x - p.last_pos->x);
+    auto diff_y = std::abs(root_y - p.last_pos->y);
+    uint16_t pos = 0;
+    border_t border;
+
+    // we need to check if we crossed a border since last pointer update. a screen change is
+    // normally handled with the leave event already, this catches one that wasn't reported.
+    if (root != p.last_pos->root) {
+        auto mp = exit_at(*p.last_pos);
+        log.debug("different root window, left at border: " + std::to_string(mp.border));
+        active = p.id;
+        ctx.mouse_at_border(*this, mp);
+    } else if (m_last != m_cur && (diff_x >= 1 || diff_y >= 1)) {
+        border = static_cast<border_t>(screen_layout.crossing(m_last, m_cur));
+        if (border == border_t::TOP || border == border_t::BOTTOM) {
+            pos = RESOLUTION * (root_x - m_cur.x) / m_cur.w;
+        } else {
+            pos = RESOLUTION * (root_y - m_cur.y) / m_cur.h;
+        }
+        log.debug("crossed from screen " + std::to_string(m_last.id) + " to " + std::to_string(m_cur.id));
+        log.debug("border: " + std::to_string(border));
+
+        active = p.id;
+        ctx.mouse_at_border(*this, {
+            .screen = static_cast<uint8_t>(m_last.id),
+            .border = border,
+            .pos = pos
+        });
+    } else {
+        // a border fires once, pushing on at it is dropped here instead of in the usb layer
+        auto b = screen_layout.border_at(root_x, root_y, root);
+        if (b && p.edges.fire(screen_layout, m_cur, b->border)) {
+            switch (b->border) {
+                case border_t::TOP:
+                case border_t::BOTTOM:
+                    pos = RESOLUTION * (root_x - b->x) / b->w;
+                    break;
+                case border_t::LEFT:
+                case border_t::RIGHT:
+                    pos = RESOLUTION * (root_y - b->y) / b->h;
+                    break;
+                default:
+                    throw std::runtime_error("invalid border");
+            }
+
+            log.debug("pointer at border " + std::to_string(b->border) + " of screen "
+                + std::to_string(b->screen));
+
+            active = p.id;
+            ctx.mouse_at_border(*this, {
+                .screen = static_cast<uint8_t>(b->screen),
+                .border = b->border,
+                .pos = pos
+            });
+        }
+    }
+    p.last_pos = { root_x, root_y, root };
+    p.budget = std::min({ root_x - m_cur.x, m_cur.x + m_cur.w - 1 - root_x,
+        root_y - m_cur.y, m_cur.y + m_cur.h - 1 - root_y }) - BORDER_WIDTH;
+}
+
+display::master_t & display::master(xcb_input_device_id_t id) {
+    auto p = std::find_if(masters.begin(), masters.end(), [&](auto const & m) { return m.id == id; });
+    if (p != masters.end()) {
+        return *p;
+    }
+
+    // a master shows up with its first event, it starts on the default screen until it enters another one
+    auto & m = masters.emplace_back(master_t {
+        .id = id,
+        .root = default_root,
+        .edges = hysteresis(std::max(opts.rearm, BORDER_WIDTH))
+    });
+    if (opts.predict > 0 && track_devices) {
+        m.predict.emplace(opts.predict);
+    }
+    return m;
+}
 
-    throw std::logic_error("pointer not inside of any known monitor");
+monitor_t const & display::get_mon_for_pos(pos_t const & pos) const {
+    return screen_layout.monitor_at(pos.x, pos.y, pos.root);
 }
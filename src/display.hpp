@@ -2,71 +2,172 @@
 
 #pragma once
 
-#include <X11/extensions/Xrandr.h>
-#include <X11/Xlib.h>
-#include <X11/extensions/XInput2.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/dpms.h>
+#include <xcb/randr.h>
+#include <xcb/screensaver.h>
+#include <xcb/xfixes.h>
+#include <xcb/xinput.h>
 
+#include <cstdlib>
+#include <list>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "context.hpp"
+#include "evdev_input.hpp"
 #include "file_descriptor.hpp"
+#include "hysteresis.hpp"
+#include "layout.hpp"
 #include "logger.hpp"
-#include "rect.hpp"
+#include "options.hpp"
+#include "predictor.hpp"
+#include "uinput_pointer.hpp"
 
 class display final {
 public:
-    display(logger &, context &);
+    display(logger &, context &, options const &, std::string const & name);
+
+    display(display const &) = delete;
+    display & operator=(display const &) = delete;
+
+    size_t screens() const { return screen_layout.get_monitors().size(); }
 
     void set_mouse_pos(mouse_pos_t const &);
     void handle_events(int);
+    // asks the server whether the session is idle, once all displays exist
+    void check_idle();
 
 private:
-    struct dsp_deleter { void operator()(Display * dsp) { XCloseDisplay(dsp); } };
-    using dsp_t = std::unique_ptr<Display, dsp_deleter>;
-
-    struct monitors_deleter { void operator()(XRRMonitorInfo * m) { XRRFreeMonitors(m); } };
-    using monitors_t = std::unique_ptr<XRRMonitorInfo, monitors_deleter>;
-
-    struct monitor_t {
-        int id;
-        int x;
-        int y;
-        int w;
-        int h;
-        Window root;
-
-        inline bool operator==(monitor_t const & other) const {
-            return std::tie(id, x, y, w, h, root) ==
-                std::tie(other.id, other.x, other.y, other.w, other.h, other.root);
-        }
-
-        inline bool operator!=(monitor_t const & other) const { return !operator==(other); }
-    };
+    struct conn_deleter { void operator()(xcb_connection_t * c) { xcb_disconnect(c); } };
+    using conn_t = std::unique_ptr<xcb_connection_t, conn_deleter>;
+
+    // replies, events and errors are allocated by xcb and released with free()
+    struct free_deleter { void operator()(void * p) { free(p); } };
+    template<typename T>
+    using reply_t = std::unique_ptr<T, free_deleter>;
 
     struct pos_t {
         int x = 0;
         int y = 0;
-        Window root = 0;
+        xcb_window_t root = 0;
+
+        bool operator==(pos_t const &) const = default;
+    };
+
+    struct motion_t {
+        pos_t pos;
+        bool button_pressed = false;
+        // master pointer that moved
+        xcb_input_device_id_t device = 0;
     };
 
+    // a master pointer, multi-pointer setups have several on one display. each is followed on its
+    // own, the device switches the pointer that reached a border.
+    struct master_t {
+        xcb_input_device_id_t id;
+        std::optional<pos_t> last_pos = {};
+        bool last_pressed = false;
+        // pixels the pointer can move from last_pos before it may reach a side of its monitor
+        int budget = 0;
+        xcb_window_t root;
+        std::optional<predictor> predict = {};
+        hysteresis edges;
+        // a uinput placement is still to be reported, the step written one unit aside before it too
+        bool warped = false;
+        std::optional<int> warp_step = {};
+    };
+
+    struct query_t {
+        unsigned int sequence;
+        xcb_input_device_id_t device;
+    };
+
+    // pointer barrier on an external part of a monitor border
+    struct barrier_t {
+        xcb_xfixes_barrier_t id;
+        size_t monitor;
+        uint8_t border;
+        // barrier event sequence that already triggered the border, until the pointer leaves
+        std::optional<uint32_t> event;
+    };
+
+    void handle_event(xcb_generic_event_t const *, std::optional<motion_t> &,
+        std::optional<xcb_input_device_id_t> & raw_motion);
+    void coalesce_motion(std::optional<motion_t> & pending, motion_t const &);
+    bool near_border(pos_t const &, monitor_t const &) const;
+    master_t & master(xcb_input_device_id_t);
+    void handle_pointer(motion_t const &);
+    void query_pointer(xcb_input_device_id_t);
+    bool handle_pointer_reply(std::optional<motion_t> &);
+    void handle_crossing(xcb_input_enter_event_t const &, std::optional<motion_t> &, bool own);
+    mouse_pos_t exit_at(pos_t const &) const;
+    void handle_barrier(xcb_input_barrier_hit_event_t const &);
+    void handle_relative_motion(int dx, int dy, bool button_pressed);
+    void predict_border(master_t &, xcb_input_raw_motion_event_t const &, std::optional<motion_t> const &);
+    void query_devices();
+    void handle_hierarchy(xcb_input_hierarchy_event_t const &);
+    void create_barriers();
+
     monitor_t const & get_mon_for_pos(pos_t const &) const;
-    void detect_screen_layout();
-    void read_screen_layout_from_file(std::string const &);
-    void add_monitor(int mon, int x, int y, int w, int h, Window);
-    void subscribe_to_motion_events(Window);
+    void check_extensions();
+    layout detect_screen_layout();
+    void update_screen_layout();
+    void set_screen_layout(layout &&);
+    void load_screen_layout();
+    layout read_screen_layout_from_file(std::string const &);
+    void watch_screen_layout_file();
+    void handle_layout_watch(int);
+    xcb_void_cookie_t subscribe_to_events(xcb_window_t, bool enable = true);
+    void set_hidden(bool);
+    void set_idle(bool);
+    void check_dpms();
+    void arm_idle_timer(long ms);
+    void handle_idle_timer(int);
 
-    std::optional<pos_t> last_pos;
-    file_descriptor xfd;
     logger & log;
     context & ctx;
-    int xi_opcode = 0;
-    dsp_t dsp;
-    std::vector<rect> border_rects;
-    std::vector<monitor_t> monitors;
+    options opts;
+    conn_t conn;
+    std::vector<xcb_window_t> roots;
+    std::vector<xcb_window_t> event_windows;
+    xcb_window_t default_root = 0;
+    uint8_t xi_opcode = 0;
+    bool master_raw = false;
+    uint8_t rr_event_base = 0;
+    uint8_t ss_event_base = 0;
+    bool dpms = false;
+    bool layout_changed = false;
+    std::optional<query_t> pointer_query;
+    std::optional<xcb_input_device_id_t> query_again;
+    layout screen_layout;
+    bool layout_from_file = false;
+    file_descriptor layout_watch;
+    std::vector<barrier_t> barriers;
+    // master() adds entries while references to others are held, a list keeps them in place
+    std::list<master_t> masters;
+    // the master that reached a border last, it is placed when the device sends a position
+    xcb_input_device_id_t active;
+    std::vector<xcb_input_device_id_t> relative_devices;
+    // slave pointers selected for raw motion instead of the masters, by name from the options
+    std::vector<xcb_input_device_id_t> raw_devices;
+    // master of each attached slave pointer
+    std::vector<std::pair<xcb_input_device_id_t, xcb_input_device_id_t>> attachments;
+    bool track_devices = false;
+    std::optional<evdev_input> evdev;
+    std::optional<uinput_pointer> pointer;
     bool hidden = false;
-    int width = 0;
-    int height = 0;
+    // screensaver active or monitors powered down, input or a position from the device ends it
+    bool idle = false;
+    file_descriptor idle_timer;
+    // shortest DPMS timeout in ms from the last check, 0 when the monitors never go dark
+    std::optional<long> dpms_timeout;
+    // sequence number of the marker request sent after the last warp, until an event from after it
+    // arrived
+    std::optional<uint32_t> warp;
+    // the server added the uinput device, placements through it reach the pointer
+    bool pointer_attached = false;
 };
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include "evdev_input.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <filesystem>
+#include <system_error>
+
+static const char INPUT_PATH[] = "/dev/input";
+
+template<size_t N>
+static bool test_bit(std::array<unsigned long, N> const & bits, unsigned int bit) {
+    return bits[bit / (sizeof(unsigned long) * CHAR_BIT)] & (1UL << (bit % (sizeof(unsigned long) * CHAR_BIT)));
+}
+
+evdev_input::evdev_input(logger & log, event_loop & el, callback && cb)
+    : log(log)
+    , el(el)
+    , cb(std::move(cb))
+    , ifd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+
+    if (!ifd.valid()) {
+        throw std::system_error(errno, std::system_category(), "failed to create inotify fd");
+    }
+
+    // device nodes show up before udev set their permissions, the attribute change is retried
+    if (inotify_add_watch(*ifd, INPUT_PATH, IN_CREATE | IN_ATTRIB) < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to watch " + std::string(INPUT_PATH));
+    }
+    el.add_fd(*ifd, std::bind(&evdev_input::handle_inotify, this, std::placeholders::_1));
+
+    for (auto const & entry : std::filesystem::directory_iterator(INPUT_PATH)) {
+        if (entry.path().filename().string().starts_with("event")) {
+            add_device(entry.path().string());
+        }
+    }
+
+    log.info("reading " + std::to_string(devices.size()) + " pointer devices from " + INPUT_PATH);
+}
+
+void evdev_input::add_device(std::string const & path) {
+    if (std::any_of(devices.begin(), devices.end(), [&](auto const & d) { return d.second.path == path; })) {
+        return;
+    }
+
+    auto fd = file_descriptor(::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+    if (!fd.valid()) {
+        if (errno == EACCES && !warned_access) {
+            log.warn("no permission to read " + path + ", is the user in the input group?");
+            warned_access = true;
+        }
+        return;
+    }
+
+    std::array<unsigned long, EV_MAX / (sizeof(unsigned long) * CHAR_BIT) + 1> ev_bits = {};
+    std::array<unsigned long, REL_MAX / (sizeof(unsigned long) * CHAR_BIT) + 1> rel_bits = {};
+    if (ioctl(*fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits.data()) < 0
+        || ioctl(*fd, EVIOCGBIT(EV_REL, sizeof(rel_bits)), rel_bits.data()) < 0) {
+        return;
+    }
+
+    if (!test_bit(ev_bits, EV_REL) || !test_bit(rel_bits, REL_X) || !test_bit(rel_bits, REL_Y)) {
+        return;
+    }
+
+    char name[256] = {};
+    ioctl(*fd, EVIOCGNAME(sizeof(name) - 1), name);
+    log.info("using pointer device " + path + ": " + name);
+
+    // no EVIOCGRAB, the X server keeps receiving the events
+    auto raw = *fd;
+    el.add_fd(raw, [this, raw](int) { handle_device(raw); });
+    devices.emplace(raw, device_t { .fd = std::move(fd), .path = path });
+}
+
+void evdev_input::remove_device(int fd) {
+    log.info("pointer device " + devices.at(fd).path + " removed");
+    el.remove_fd(fd);
+    devices.erase(fd);
+}
+
+void evdev_input::handle_device(int fd) {
+    auto & dev = devices.at(fd);
+
+    std::array<input_event, 64> events;
+    for (;;) {
+        auto len = ::read(fd, events.data(), sizeof(events));
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                return;
+            }
+            if (errno == ENODEV) {
+                remove_device(fd);
+                return;
+            }
+            throw std::system_error(errno, std::system_category(), "failed to read " + dev.path);
+        }
+
+        for (size_t i = 0; i < len / sizeof(input_event); ++i) {
+            auto const & ev = events[i];
+            switch (ev.type) {
+                case EV_REL:
+                    if (ev.code == REL_X) {
+                        dev.dx += ev.value;
+                    } else if (ev.code == REL_Y) {
+                        dev.dy += ev.value;
+                    }
+                    break;
+                case EV_KEY:
+                    if (ev.code >= BTN_MOUSE && ev.code < BTN_JOYSTICK) {
+                        auto mask = 1u << (ev.code - BTN_MOUSE);
+                        dev.buttons = ev.value ? dev.buttons | mask : dev.buttons & ~mask;
+                    }
+                    break;
+                case EV_SYN:
+                    if (ev.code == SYN_DROPPED) {
+                        // the kernel buffer overflowed, the frame is incomplete
+                        dev.dx = dev.dy = 0;
+                    } else if (ev.code == SYN_REPORT && (dev.dx || dev.dy)) {
+                        auto dx = dev.dx;
+                        auto dy = dev.dy;
+                        dev.dx = dev.dy = 0;
+                        cb(dx, dy, button_pressed());
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+void evdev_input::handle_inotify(int) {
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        auto len = ::read(*ifd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                return;
+            }
+            throw std::system_error(errno, std::system_category(), "failed to read inotify fd");
+        }
+
+        for (auto p = buf; p < buf + len;) {
+            auto ev = reinterpret_cast<inotify_event const *>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->len && std::string(ev->name).starts_with("event")) {
+                add_device(std::string(INPUT_PATH) + "/" + ev->name);
+            }
+        }
+    }
+}
+
+bool evdev_input::button_pressed() const {
+    return std::any_of(devices.begin(), devices.end(), [](auto const & d) { return d.second.buttons != 0; });
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <linux/input.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "event_loop.hpp"
+#include "file_descriptor.hpp"
+#include "logger.hpp"
+
+// Relative pointer devices (mice, trackballs) read straight from /dev/input next to the X server,
+// the devices are not grabbed. The deltas of every input frame are reported together with the
+// button state of all devices. Devices plugged in later are picked up through inotify.
+class evdev_input final {
+public:
+    using callback = std::function<void(int dx, int dy, bool button_pressed)>;
+
+    evdev_input(logger &, event_loop &, callback &&);
+
+    evdev_input(evdev_input const &) = delete;
+    evdev_input & operator=(evdev_input const &) = delete;
+
+private:
+    struct device_t {
+        file_descriptor fd;
+        std::string path;
+        int dx = 0;
+        int dy = 0;
+        unsigned int buttons = 0;
+    };
+
+    void add_device(std::string const & path);
+    void remove_device(int fd);
+    void handle_device(int fd);
+    void handle_inotify(int);
+    bool button_pressed() const;
+
+    logger & log;
+    event_loop & el;
+    callback cb;
+    file_descriptor ifd;
+    std::unordered_map<int, device_t> devices;
+    bool warned_access = false;
+};
@@ -28,12 +28,23 @@ void event_loop::run() {
         }
 
         for (auto i = 0; i < fds; ++i) {
-            if (!fd_handlers.contains(events[i].data.fd)) {
+            if (removed.contains(events[i].data.fd)) {
+                continue;
+            }
+
+            auto handler = fd_handlers.find(events[i].data.fd);
+            if (handler == fd_handlers.end()) {
                 throw std::logic_error("epoll returned unknown fd");
             }
 
-            fd_handlers[events[i].data.fd](EPOLLIN);
+            // the handler may remove itself, it is erased after the batch
+            handler->second(EPOLLIN);
         }
+
+        for (auto fd : removed) {
+            fd_handlers.erase(fd);
+        }
+        removed.clear();
     }
 }
 
@@ -47,5 +58,17 @@ void event_loop::add_fd(int fd, callback && cb) {
     }
 
     log.debug("added fd handler for fd " + std::to_string(fd));
-    fd_handlers.emplace(fd, std::move(cb));
+    // a reused fd number may still hold the handler of the removed fd until the batch ends
+    fd_handlers.insert_or_assign(fd, std::move(cb));
+    removed.erase(fd);
+}
+
+void event_loop::remove_fd(int fd) {
+    if (epoll_ctl(*epoll_fd, EPOLL_CTL_DEL, fd, nullptr) < 0) {
+        throw std::system_error(errno, std::system_category(), "epoll_ctl failed");
+    }
+
+    log.debug("removed fd handler for fd " + std::to_string(fd));
+    // the handler may be running, events of the current batch may still refer to it
+    removed.insert(fd);
 }
@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "file_descriptor.hpp"
 #include "logger.hpp"
@@ -15,9 +16,11 @@ public:
     event_loop(logger &);
     void run();
     void add_fd(int fd, callback && cb);
+    void remove_fd(int fd);
 
 private:
     logger & log;
     file_descriptor epoll_fd;
     std::unordered_map<int, callback> fd_handlers;
+    std::unordered_set<int> removed;
 };
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include "hysteresis.hpp"
+
+#include <algorithm>
+
+#include "types.hpp"
+
+bool hysteresis::fire(layout const & l, monitor_t const & m, uint8_t border) {
+    size_t idx = &m - l.get_monitors().data();
+    auto same = [&](auto const & e) { return e.monitor == idx && e.border == border; };
+    if (std::any_of(disarmed.begin(), disarmed.end(), same)) {
+        return false;
+    }
+
+    disarmed.push_back({ idx, border });
+    return true;
+}
+
+void hysteresis::update(layout const & l, int x, int y, xcb_window_t root) {
+    // only the distance across the border counts, sliding along it keeps it disarmed
+    std::erase_if(disarmed, [&](auto const & e) {
+        auto const & m = l.get_monitors()[e.monitor];
+        int away = 0;
+        switch (e.border) {
+            case border_t::LEFT:
+                away = x - m.x;
+                break;
+            case border_t::RIGHT:
+                away = m.x + m.w - 1 - x;
+                break;
+            case border_t::TOP:
+                away = y - m.y;
+                break;
+            case border_t::BOTTOM:
+                away = m.y + m.h - 1 - y;
+                break;
+        }
+        return m.root != root || away > distance;
+    });
+}
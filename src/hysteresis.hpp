@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <vector>
+
+#include "layout.hpp"
+
+// Arm state of the external borders. A border fires once when the pointer gets there and is
+// disarmed until the pointer moved more than the re-arm distance (in pixels) away from it, left
+// its screen or everything is re-armed because the device sent a new position.
+class hysteresis final {
+public:
+    explicit hysteresis(int distance) : distance(distance) { }
+
+    // true if the border of the monitor is armed, it is disarmed with that
+    bool fire(layout const &, monitor_t const &, uint8_t border);
+    void update(layout const &, int x, int y, xcb_window_t root);
+    void rearm() { disarmed.clear(); }
+
+private:
+    struct edge_t {
+        size_t monitor;
+        uint8_t border;
+    };
+
+    int distance;
+    std::vector<edge_t> disarmed;
+};
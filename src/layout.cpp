@@ -0,0 +1,396 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include "layout.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "types.hpp"
+
+static const size_t GAP = std::numeric_limits<size_t>::max();
+static const size_t BATCH_LANES = 8;
+
+// border of each strip lane
+static const uint8_t LANES[4] = { border_t::LEFT, border_t::TOP, border_t::RIGHT, border_t::BOTTOM };
+
+// whether any lane of a compare result is set
+template<typename T>
+static bool any(T const & v) {
+    uint64_t h[sizeof(v) / 8];
+    std::memcpy(h, &v, sizeof(v));
+    return (h[0] | h[1]) != 0;
+}
+
+static rect strip_rect(monitor_t const & m, int lane, int bw) {
+    switch (LANES[lane]) {
+        case border_t::LEFT:
+            return rect(m.x, m.y, bw, m.h, m.id, border_t::LEFT, m.root);
+        case border_t::TOP:
+            return rect(m.x, m.y, m.w, bw, m.id, border_t::TOP, m.root);
+        case border_t::RIGHT:
+            return rect(m.x + m.w - bw, m.y, bw, m.h, m.id, border_t::RIGHT, m.root);
+        default:
+            return rect(m.x, m.y + m.h - bw, m.w, bw, m.id, border_t::BOTTOM, m.root);
+    }
+}
+
+void layout::add_monitor(int mon, int x, int y, int w, int h, xcb_window_t root, int border_width) {
+    this->border_width = border_width;
+    monitors.emplace_back(monitor_t { .id = mon, .x = x, .y = y, .w = w, .h = h, .root = root });
+    this->w = std::max(x + w, this->w);
+    this->h = std::max(y + h, this->h);
+
+    auto grid = std::find_if(grids.begin(), grids.end(), [&](auto const & g) { return g.root == root; });
+    if (grid == grids.end()) {
+        grid = grids.insert(grids.end(), grid_t {});
+        grid->root = root;
+    }
+}
+
+void layout::finalize() {
+    for (auto & grid : grids) {
+        build_grid(grid);
+    }
+    build_topology();
+    build_strips();
+}
+
+void layout::build_grid(grid_t & grid) {
+    grid.xs.clear();
+    grid.ys.clear();
+    for (auto const & m : monitors) {
+        if (m.root == grid.root) {
+            grid.xs.insert(grid.xs.end(), { m.x, m.x + m.w });
+            grid.ys.insert(grid.ys.end(), { m.y, m.y + m.h });
+        }
+    }
+
+    for (auto v : { &grid.xs, &grid.ys }) {
+        std::sort(v->begin(), v->end());
+        v->erase(std::unique(v->begin(), v->end()), v->end());
+    }
+
+    // cells are the intervals between neighboring boundaries, the first monitor covering a cell
+    // wins, cells in gaps between monitors are marked and resolved on lookup
+    auto cols = grid.xs.size() - 1;
+    auto rows = grid.ys.size() - 1;
+    grid.cells.assign(cols * rows, GAP);
+
+    for (size_t i = monitors.size(); i-- > 0;) {
+        auto const & m = monitors[i];
+        if (m.root != grid.root) {
+            continue;
+        }
+
+        auto c0 = std::lower_bound(grid.xs.begin(), grid.xs.end(), m.x) - grid.xs.begin();
+        auto c1 = std::lower_bound(grid.xs.begin(), grid.xs.end(), m.x + m.w) - grid.xs.begin();
+        auto r0 = std::lower_bound(grid.ys.begin(), grid.ys.end(), m.y) - grid.ys.begin();
+        auto r1 = std::lower_bound(grid.ys.begin(), grid.ys.end(), m.y + m.h) - grid.ys.begin();
+
+        for (auto r = r0; r < r1; ++r) {
+            for (auto c = c0; c < c1; ++c) {
+                grid.cells[r * cols + c] = i;
+            }
+        }
+    }
+}
+
+void layout::build_topology() {
+    auto n = monitors.size();
+    external_edges.assign(n * 4, {});
+    crossings.assign(n * n, border_t::HIDE);
+
+    auto overlap = [](int a0, int a1, int b0, int b1) {
+        return std::max(a0, b0) < std::min(a1, b1);
+    };
+
+    for (size_t i = 0; i < n; ++i) {
+        auto const & a = monitors[i];
+
+        // the line of pixels just outside of each border and the range along it
+        struct { uint8_t border; bool vertical; int line; int from; int to; } edges[] = {
+            { border_t::LEFT, true, a.x - 1, a.y, a.y + a.h },
+            { border_t::TOP, false, a.y - 1, a.x, a.x + a.w },
+            { border_t::RIGHT, true, a.x + a.w, a.y, a.y + a.h },
+            { border_t::BOTTOM, false, a.y + a.h, a.x, a.x + a.w },
+        };
+
+        for (auto const & e : edges) {
+            std::vector<segment_t> covered;
+            for (size_t j = 0; j < n; ++j) {
+                auto const & b = monitors[j];
+                if (j == i || b.root != a.root) {
+                    continue;
+                }
+
+                bool touches = e.vertical
+                    ? e.line >= b.x && e.line < b.x + b.w && overlap(e.from, e.to, b.y, b.y + b.h)
+                    : e.line >= b.y && e.line < b.y + b.h && overlap(e.from, e.to, b.x, b.x + b.w);
+
+                if (touches) {
+                    crossings[i * n + j] = e.border;
+                    covered.push_back(e.vertical
+                        ? segment_t { std::max(e.from, b.y), std::min(e.to, b.y + b.h) }
+                        : segment_t { std::max(e.from, b.x), std::min(e.to, b.x + b.w) });
+                }
+            }
+
+            // whatever no neighbor covers is external
+            std::sort(covered.begin(), covered.end(), [](auto const & l, auto const & r) { return l.from < r.from; });
+            auto & ext = external_edges[i * 4 + e.border];
+            auto cur = e.from;
+            for (auto const & c : covered) {
+                if (c.from > cur) {
+                    ext.push_back({ cur, c.from });
+                }
+                cur = std::max(cur, c.to);
+            }
+            if (cur < e.to) {
+                ext.push_back({ cur, e.to });
+            }
+        }
+
+        // monitors that don't touch are classified by the direction of their centers
+        for (size_t j = 0; j < n; ++j) {
+            auto const & b = monitors[j];
+            if (j == i || crossings[i * n + j] != border_t::HIDE) {
+                continue;
+            }
+
+            long dx = (2L * b.x + b.w) - (2L * a.x + a.w);
+            long dy = (2L * b.y + b.h) - (2L * a.y + a.h);
+            if (std::abs(dx) * a.h > std::abs(dy) * a.w) {
+                crossings[i * n + j] = dx > 0 ? border_t::RIGHT : border_t::LEFT;
+            } else {
+                crossings[i * n + j] = dy > 0 ? border_t::BOTTOM : border_t::TOP;
+            }
+        }
+    }
+}
+
+void layout::build_strips() {
+    auto n = monitors.size();
+    strips.x0.assign(n, lanes_t {});
+    strips.y0.assign(n, lanes_t {});
+    strips.x1.assign(n, lanes_t {});
+    strips.y1.assign(n, lanes_t {});
+    strips.partial.assign(n, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        auto const & m = monitors[i];
+        for (int k = 0; k < 4; ++k) {
+            auto const & ext = external_edges[i * 4 + LANES[k]];
+            if (ext.empty()) {
+                // nothing can be inside
+                strips.x0[i][k] = std::numeric_limits<int32_t>::max();
+                strips.x1[i][k] = std::numeric_limits<int32_t>::min();
+                continue;
+            }
+
+            // across the border the strip includes its far edge, along it the monitor's extent counts
+            auto r = strip_rect(m, k, border_width);
+            bool vertical = LANES[k] == border_t::LEFT || LANES[k] == border_t::RIGHT;
+            strips.x0[i][k] = r.x;
+            strips.y0[i][k] = r.y;
+            strips.x1[i][k] = vertical ? r.x + r.w : m.x + m.w - 1;
+            strips.y1[i][k] = vertical ? m.y + m.h - 1 : r.y + r.h;
+
+            auto from = vertical ? m.y : m.x;
+            auto to = vertical ? m.y + m.h : m.x + m.w;
+            if (ext.size() != 1 || ext.front().from != from || ext.front().to != to) {
+                strips.partial[i] |= 1 << k;
+            }
+        }
+    }
+}
+
+size_t layout::nearest(grid_t const & grid, int x, int y) const {
+    auto best = std::numeric_limits<long>::max();
+    size_t idx = 0;
+
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        auto const & m = monitors[i];
+        if (m.root != grid.root) {
+            continue;
+        }
+
+        long dx = std::max({ m.x - x, 0, x - (m.x + m.w - 1) });
+        long dy = std::max({ m.y - y, 0, y - (m.y + m.h - 1) });
+        if (dx * dx + dy * dy < best) {
+            best = dx * dx + dy * dy;
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+size_t layout::lookup(grid_t const & grid, int x, int y) const {
+    if (x < grid.xs.front() || x >= grid.xs.back() || y < grid.ys.front() || y >= grid.ys.back()) {
+        return nearest(grid, x, y);
+    }
+
+    auto col = std::upper_bound(grid.xs.begin(), grid.xs.end(), x) - grid.xs.begin() - 1;
+    auto row = std::upper_bound(grid.ys.begin(), grid.ys.end(), y) - grid.ys.begin() - 1;
+    auto idx = grid.cells[row * (grid.xs.size() - 1) + col];
+
+    return idx == GAP ? nearest(grid, x, y) : idx;
+}
+
+monitor_t const & layout::monitor_at(int x, int y, xcb_window_t root) const {
+    if (monitors.empty()) {
+        throw std::logic_error("no monitors in layout");
+    }
+
+    auto const & last = monitors[hint];
+    if ((root == last.root || root == 0)
+        && x >= last.x && x < last.x + last.w && y >= last.y && y < last.y + last.h) {
+        return last;
+    }
+
+    auto grid = std::find_if(grids.begin(), grids.end(), [&](auto const & g) { return g.root == root; });
+    if (grid == grids.end()) {
+        // unknown root, e.g. a position without root: take the first root that covers the position
+        grid = std::find_if(grids.begin(), grids.end(), [&](auto const & g) {
+            auto const & m = monitors[lookup(g, x, y)];
+            return x >= m.x && x < m.x + m.w && y >= m.y && y < m.y + m.h;
+        });
+
+        if (grid == grids.end()) {
+            grid = grids.begin();
+        }
+    }
+
+    hint = lookup(*grid, x, y);
+    return monitors[hint];
+}
+
+std::optional<rect> layout::border_at(int x, int y, xcb_window_t root) const {
+    auto idx = classify(x, y, root);
+    if (idx < 0) {
+        return {};
+    }
+
+    return strip(idx);
+}
+
+int layout::classify(int x, int y, xcb_window_t root) const {
+    auto const & m = monitor_at(x, y, root);
+    if (m.root != root && root != 0) {
+        return -1;
+    }
+
+    // borders shared with another monitor are crossed, not hit: their strips are empty or marked
+    // partial and checked against the external segments
+    size_t i = &m - monitors.data();
+    lanes_t px = lanes_t {} + x;
+    lanes_t py = lanes_t {} + y;
+    lanes_t in = (px >= strips.x0[i]) & (px <= strips.x1[i]) & (py >= strips.y0[i]) & (py <= strips.y1[i]);
+
+    for (int k = 0; k < 4; ++k) {
+        if (!in[k]) {
+            continue;
+        }
+
+        bool vertical = LANES[k] == border_t::LEFT || LANES[k] == border_t::RIGHT;
+        if (!(strips.partial[i] & (1 << k)) || is_external(m, LANES[k], vertical ? y : x)) {
+            return static_cast<int>(i * 4 + k);
+        }
+    }
+
+    return -1;
+}
+
+void layout::classify(std::span<position_t const> in, std::span<int> out) const {
+    if (out.size() < in.size()) {
+        throw std::invalid_argument("classify: output smaller than input");
+    }
+
+    // consecutive positions of a trace mostly stay on one monitor: runs of positions on the monitor
+    // of the first one are compared against its strips at once, the others one at a time
+    for (size_t i = 0; i < in.size(); i += BATCH_LANES) {
+        auto n = std::min(in.size() - i, BATCH_LANES);
+        if (n == BATCH_LANES && classify_run(in.subspan(i, n), out.subspan(i, n))) {
+            continue;
+        }
+
+        for (auto k = i; k < i + n; ++k) {
+            out[k] = classify(in[k].x, in[k].y, in[k].root);
+        }
+    }
+}
+
+bool layout::classify_run(std::span<position_t const> in, std::span<int> out) const {
+    auto const & m = monitor_at(in[0].x, in[0].y, in[0].root);
+    size_t i = &m - monitors.data();
+
+    // the positions go into vectors of the native width, four lanes each
+    constexpr size_t N = BATCH_LANES / 4;
+    alignas(lanes_t) int32_t xs[BATCH_LANES], ys[BATCH_LANES];
+    bool same_root = true;
+    for (size_t k = 0; k < BATCH_LANES; ++k) {
+        xs[k] = in[k].x;
+        ys[k] = in[k].y;
+        same_root &= in[k].root == m.root;
+    }
+    lanes_t px[N], py[N];
+    std::memcpy(px, xs, sizeof(px));
+    std::memcpy(py, ys, sizeof(py));
+
+    // every position has to be on the monitor, the lookup would return it for each of them
+    lanes_t off = {};
+    for (size_t h = 0; h < N; ++h) {
+        off |= (px[h] < m.x) | (px[h] >= m.x + m.w) | (py[h] < m.y) | (py[h] >= m.y + m.h);
+    }
+    if (!same_root || any(off)) {
+        return false;
+    }
+
+    // the strips are tested in reverse, the first one holding a position wins like in the single
+    // classify()
+    lanes_t idx[N], partial[N], any_partial = {};
+    for (size_t h = 0; h < N; ++h) {
+        idx[h] = lanes_t {} - 1;
+        partial[h] = lanes_t {};
+        for (int k = 4; k-- > 0;) {
+            lanes_t hit = (px[h] >= strips.x0[i][k]) & (px[h] <= strips.x1[i][k])
+                & (py[h] >= strips.y0[i][k]) & (py[h] <= strips.y1[i][k]);
+            idx[h] = (hit & static_cast<int32_t>(i * 4 + k)) | (~hit & idx[h]);
+            partial[h] |= hit & -((strips.partial[i] >> k) & 1);
+        }
+        any_partial |= partial[h];
+    }
+    std::memcpy(out.data(), idx, sizeof(idx));
+
+    // positions on a partly external strip are checked against the segments
+    if (any(any_partial)) {
+        std::memcpy(xs, partial, sizeof(partial));
+        for (size_t k = 0; k < BATCH_LANES; ++k) {
+            if (xs[k]) {
+                out[k] = classify(in[k].x, in[k].y, in[k].root);
+            }
+        }
+    }
+
+    return true;
+}
+
+rect layout::strip(int idx) const {
+    return strip_rect(monitors.at(idx / 4), idx % 4, border_width);
+}
+
+bool layout::is_external(monitor_t const & m, uint8_t border, int along) const {
+    for (auto const & seg : external_edges[(&m - monitors.data()) * 4 + border]) {
+        if (along >= seg.from && along < seg.to) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint8_t layout::crossing(monitor_t const & from, monitor_t const & to) const {
+    return crossings[(&from - monitors.data()) * monitors.size() + (&to - monitors.data())];
+}
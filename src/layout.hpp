@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <xcb/xproto.h>
+
+#include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "rect.hpp"
+
+struct monitor_t {
+    int id;
+    int x;
+    int y;
+    int w;
+    int h;
+    xcb_window_t root;
+
+    inline bool operator==(monitor_t const & other) const {
+        return std::tie(id, x, y, w, h, root) ==
+            std::tie(other.id, other.x, other.y, other.w, other.h, other.root);
+    }
+
+    inline bool operator!=(monitor_t const & other) const { return !operator==(other); }
+};
+
+// Monitor geometry of a display with a lookup grid per root window. The grid is built from the
+// sorted monitor boundaries, every cell refers to the monitor covering it. Positions in gaps
+// between monitors or outside of them map to the nearest monitor.
+//
+// The topology is computed along with it: which parts of a monitor's borders lead to another
+// monitor (internal) or to nothing (external), and through which border each monitor is left
+// towards every other one.
+//
+// The border strips are kept as structure of arrays, the four strips of a monitor side by side in
+// the lanes of a vector. A position is tested against all strips of its monitor with one compare
+// per bound, the cost doesn't depend on the number of monitors.
+class layout final {
+public:
+    // part of a monitor border, [from, to) along the border
+    struct segment_t {
+        int from;
+        int to;
+    };
+
+    struct position_t {
+        int x;
+        int y;
+        xcb_window_t root;
+    };
+
+    // lookups need finalize() after the last monitor was added, it builds the grids, the topology
+    // and the strips at once
+    void add_monitor(int mon, int x, int y, int w, int h, xcb_window_t root, int border_width);
+    void finalize();
+
+    monitor_t const & monitor_at(int x, int y, xcb_window_t root) const;
+    std::optional<rect> border_at(int x, int y, xcb_window_t root) const;
+
+    // the external border strip holding the position as monitor index * 4 + lane, -1 if none
+    int classify(int x, int y, xcb_window_t root) const;
+    // the same for a batch of positions, e.g. a recorded trace. runs of eight positions on one
+    // monitor are compared at once. out needs the size of in.
+    void classify(std::span<position_t const> in, std::span<int> out) const;
+    rect strip(int idx) const;
+    uint8_t crossing(monitor_t const & from, monitor_t const & to) const;
+
+    bool is_external(monitor_t const &, uint8_t border, int along) const;
+
+    // parts of a border of the monitor at index mon that lead to no other monitor
+    std::vector<segment_t> const & external(size_t mon, uint8_t border) const {
+        return external_edges[mon * 4 + border];
+    }
+
+    std::vector<monitor_t> const & get_monitors() const { return monitors; }
+    bool empty() const { return monitors.empty(); }
+    int width() const { return w; }
+    int height() const { return h; }
+
+private:
+    struct grid_t {
+        xcb_window_t root;
+        std::vector<int> xs;
+        std::vector<int> ys;
+        std::vector<size_t> cells;
+    };
+
+    // four int32 lanes, the strips of one monitor in the order LEFT, TOP, RIGHT, BOTTOM
+    typedef int32_t lanes_t __attribute__((vector_size(16)));
+
+    // inclusive bounds of the strips, strips without an external part are empty. partial has a bit
+    // per lane for strips that are external in parts only, a hit is checked against the segments.
+    struct strips_t {
+        std::vector<lanes_t> x0;
+        std::vector<lanes_t> y0;
+        std::vector<lanes_t> x1;
+        std::vector<lanes_t> y1;
+        std::vector<uint8_t> partial;
+    };
+
+    void build_grid(grid_t &);
+    void build_topology();
+    void build_strips();
+    bool classify_run(std::span<position_t const> in, std::span<int> out) const;
+    size_t lookup(grid_t const &, int x, int y) const;
+    size_t nearest(grid_t const &, int x, int y) const;
+
+    std::vector<monitor_t> monitors;
+    strips_t strips;
+    int border_width = 1;
+    std::vector<grid_t> grids;
+    std::vector<std::vector<segment_t>> external_edges;
+    std::vector<uint8_t> crossings;
+    mutable size_t hint = 0;
+    int w = 0;
+    int h = 0;
+};
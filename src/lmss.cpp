@@ -4,13 +4,29 @@
 
 #include <sys/timerfd.h>
 
-lmss::lmss(logger & log)
+lmss::lmss(logger & log, options const & opts)
     : log(log)
     , el(log)
     , usb(log, *this)
-    , dsp(log, *this)
     , tfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
 
+    // one usb device serves the screens of all displays. the layout file describes the first one,
+    // a uinput device would show up in every X server on the machine and only serves the first one.
+    auto names = opts.displays.empty() ? std::vector<std::string> { "" } : opts.displays;
+    for (auto const & name : names) {
+        auto dsp_opts = opts;
+        if (!displays.empty()) {
+            dsp_opts.layout_file.clear();
+            dsp_opts.uinput = false;
+        }
+        displays.push_back(std::make_unique<display>(log, *this, dsp_opts, name));
+    }
+
+    // the device is only slowed down when all displays are idle, they are asked once all are counted
+    for (auto & d : displays) {
+        d->check_idle();
+    }
+
     if (!tfd.valid()) {
         throw std::runtime_error("invalid timer fd");
     }
@@ -39,9 +55,49 @@ void lmss::heartbeat(int) {
 }
 
 void lmss::set_mouse_pos(mouse_pos_t const & mp) {
-    dsp.set_mouse_pos(mp);
+    size_t total = 0;
+    for (auto const & d : displays) {
+        total += d->screens();
+    }
+    if (mp.screen >= total) {
+        log.warn("position for unknown screen " + std::to_string(mp.screen));
+        return;
+    }
+
+    // the display owning the screen gets the position, the others hide their cursor once when they
+    // lose the pointer
+    size_t first = 0;
+    for (auto const & d : displays) {
+        auto screens = d->screens();
+        if (mp.screen >= first && mp.screen < first + screens) {
+            d->set_mouse_pos({ static_cast<uint8_t>(mp.screen - first), mp.border, mp.pos });
+            hidden_displays.erase(d.get());
+        } else if (screens > 0 && hidden_displays.insert(d.get()).second) {
+            d->set_mouse_pos({ 0, border_t::HIDE, 0 });
+        }
+        first += screens;
+    }
+}
+
+void lmss::mouse_at_border(display const & source, mouse_pos_t const & mp) {
+    uint8_t first = 0;
+    for (auto const & d : displays) {
+        if (d.get() == &source) {
+            break;
+        }
+        first += d->screens();
+    }
+
+    usb.send_mouse_pos({ static_cast<uint8_t>(first + mp.screen), mp.border, mp.pos });
 }
 
-void lmss::mouse_at_border(mouse_pos_t const & mp) {
-    usb.send_mouse_pos(mp);
+void lmss::set_idle(display const & source, bool idle) {
+    if (idle) {
+        idle_displays.insert(&source);
+    } else {
+        idle_displays.erase(&source);
+    }
+
+    // the device is polled slowly only while nobody works on any of the displays
+    usb.set_idle(idle_displays.size() == displays.size());
 }
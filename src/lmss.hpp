@@ -2,19 +2,25 @@
 
 #pragma once
 
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
 #include "context.hpp"
 #include "display.hpp"
 #include "event_loop.hpp"
+#include "options.hpp"
 #include "usb.hpp"
 
 
 class lmss final : public context {
 public:
-    lmss(logger &);
+    lmss(logger &, options const &);
 
     event_loop & get_el() override { return el; }
     void set_mouse_pos(mouse_pos_t const &) override;
-    void mouse_at_border(mouse_pos_t const &) override;
+    void mouse_at_border(display const &, mouse_pos_t const &) override;
+    void set_idle(display const &, bool) override;
 
     void run() { el.run(); }
 
@@ -24,6 +30,9 @@ private:
     logger & log;
     event_loop el;
     usb_dev usb;
-    display dsp;
+    std::vector<std::unique_ptr<display>> displays;
+    std::unordered_set<display const *> idle_displays;
+    // displays told to hide their pointer since they lost it to another display
+    std::unordered_set<display const *> hidden_displays;
     file_descriptor tfd;
 };
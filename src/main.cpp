@@ -7,6 +7,7 @@
 #include "config.hpp"
 #include "lmss.hpp"
 #include "logger.hpp"
+#include "options.hpp"
 
 int main(int argc, char* argv[]) {
     argparse::ArgumentParser app("lmss", VERSION, argparse::default_arguments::help);
@@ -21,6 +22,38 @@ int main(int argc, char* argv[]) {
         .default_value(false)
         .implicit_value(true)
         .help("print lmss version");
+    app.add_argument("-d", "--display")
+        .metavar("DISPLAY")
+        .append()
+        .help("X display to serve, repeat for several displays (default: $DISPLAY)");
+    app.add_argument("-D", "--device")
+        .metavar("NAME")
+        .append()
+        .help("follow the raw motion of this pointer device only, repeat for several (default: master pointers)");
+    app.add_argument("-b", "--barriers")
+        .default_value(false)
+        .implicit_value(true)
+        .help("detect borders with pointer barriers on the outer screen edges");
+    app.add_argument("-e", "--evdev")
+        .default_value(false)
+        .implicit_value(true)
+        .help("read pointer motion from /dev/input, the X server still corrects the position");
+    app.add_argument("-u", "--uinput")
+        .default_value(false)
+        .implicit_value(true)
+        .help("place the pointer through an absolute uinput device instead of warping it");
+    app.add_argument("-p", "--predict")
+        .default_value(0)
+        .metavar("PIXELS")
+        .nargs(1)
+        .scan<'i', int>()
+        .help("trigger a border ahead of the pointer once the raw motion pushed this far into it (0: off)");
+    app.add_argument("-r", "--rearm")
+        .default_value(16)
+        .metavar("PIXELS")
+        .nargs(1)
+        .scan<'i', int>()
+        .help("distance the pointer has to move away from a border before it triggers again");
 
     try {
         app.parse_args(argc, argv);
@@ -39,9 +72,27 @@ int main(int argc, char* argv[]) {
 
     logger log("LMSS", log_level);
 
+    options opts;
+    if (auto displays = app.present<std::vector<std::string>>("--display")) {
+        opts.displays = *displays;
+    }
+    if (auto devices = app.present<std::vector<std::string>>("--device")) {
+        opts.devices = *devices;
+    }
+    opts.barriers = app.get<bool>("--barriers");
+    opts.predict = app.get<int>("--predict");
+    opts.rearm = app.get<int>("--rearm");
+    opts.evdev = app.get<bool>("--evdev");
+    opts.uinput = app.get<bool>("--uinput");
+
+    if (opts.barriers && (opts.evdev || opts.predict)) {
+        std::cerr << "--barriers can't be combined with --evdev or --predict" << std::endl;
+        std::exit(1);
+    }
+
     while (true) {
         try {
-            lmss l(log);
+            lmss l(log, opts);
             l.run();
         } catch (std::runtime_error const & e) {
             log.err(e.what());
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// settings from the command line
+struct options {
+    // X displays to serve, their screens are numbered one display after the other. the default
+    // display ($DISPLAY) if empty.
+    std::vector<std::string> displays;
+
+    // screen layout overriding RandR, not used if empty
+    std::string layout_file = "/etc/lmss.sl";
+
+    // detect borders with pointer barriers on the external screen edges instead of following
+    // every pointer motion
+    bool barriers = false;
+
+    // pointer devices (XI names) whose raw motion is followed, the master pointers if empty
+    std::vector<std::string> devices;
+
+    // read relative pointer motion from evdev instead of waiting for the server's raw motion
+    bool evdev = false;
+
+    // place the pointer with an absolute uinput device instead of warping it
+    bool uinput = false;
+
+    // push into an external edge (in pixels of raw motion) that triggers the border before the
+    // pointer reaches it, 0 disables the prediction
+    int predict = 0;
+
+    // distance (in pixels) the pointer has to move away from a border it triggered before the
+    // border triggers again, unless the device sent a position in between
+    int rearm = 16;
+};
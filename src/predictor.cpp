@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include "predictor.hpp"
+
+#include <algorithm>
+
+std::optional<mouse_pos_t> predictor::push(layout const & l, int x, int y, xcb_window_t root, double dx, double dy) {
+    auto const & m = l.monitor_at(x, y, root);
+
+    // the external border the motion carries the pointer furthest beyond
+    uint8_t target = border_t::HIDE;
+    double beyond = 0;
+    auto check = [&](uint8_t b, double delta, int distance, int along) {
+        if (delta - distance > beyond && l.is_external(m, b, along)) {
+            target = b;
+            beyond = delta - distance;
+        }
+    };
+
+    if (dx < 0) {
+        check(border_t::LEFT, -dx, x - m.x, y);
+    } else if (dx > 0) {
+        check(border_t::RIGHT, dx, m.x + m.w - 1 - x, y);
+    }
+    if (dy < 0) {
+        check(border_t::TOP, -dy, y - m.y, x);
+    } else if (dy > 0) {
+        check(border_t::BOTTOM, dy, m.y + m.h - 1 - y, x);
+    }
+
+    if (target == border_t::HIDE) {
+        reset();
+        return {};
+    }
+
+    if (target != border) {
+        reset();
+        border = target;
+    }
+
+    distance += beyond;
+    if (triggered || distance < threshold) {
+        return {};
+    }
+    triggered = true;
+
+    // where the pointer arrives at the border
+    auto ax = std::clamp(x + static_cast<int>(dx), m.x, m.x + m.w - 1);
+    auto ay = std::clamp(y + static_cast<int>(dy), m.y, m.y + m.h - 1);
+    uint16_t pos = border == border_t::TOP || border == border_t::BOTTOM
+        ? RESOLUTION * (ax - m.x) / m.w
+        : RESOLUTION * (ay - m.y) / m.h;
+
+    return mouse_pos_t { .screen = static_cast<uint8_t>(m.id), .border = border, .pos = pos };
+}
+
+void predictor::reset() {
+    border = border_t::HIDE;
+    distance = 0;
+    triggered = false;
+}
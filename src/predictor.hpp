@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <optional>
+
+#include "layout.hpp"
+#include "types.hpp"
+
+// Detects a push into an external border from relative pointer motion before the pointer shows up
+// in the border strip. Every delta is projected from the last known position, what the motion
+// carries beyond an external border adds up as long as the pointer keeps pushing into the same
+// border. The border triggers once per push when the sum reaches the threshold (in pixels).
+class predictor final {
+public:
+    explicit predictor(int threshold) : threshold(threshold) { }
+
+    std::optional<mouse_pos_t> push(layout const &, int x, int y, xcb_window_t root, double dx, double dy);
+    void reset();
+
+private:
+    int threshold;
+    uint8_t border = border_t::HIDE;
+    double distance = 0;
+    bool triggered = false;
+};
@@ -1,15 +1,15 @@
 /* SPDX-License-Identifier: BSD-3-Clause */
 
 #pragma once
-#include <X11/Xlib.h>
+#include <xcb/xproto.h>
 
 #include <stdint.h>
 
 struct rect {
-    rect(int x, int y, int w, int h, int screen, uint8_t border, Window root)
+    rect(int x, int y, int w, int h, int screen, uint8_t border, xcb_window_t root)
         : x(x), y(y), w(w), h(h), screen(screen), border(border), root(root) { }
 
-    bool inside(int px, int py) {
+    bool inside(int px, int py) const {
         return px >= x && px <= x + w && py >= y && py <= y + h;
     }
 
@@ -19,5 +19,5 @@ struct rect {
     int h;
     int screen;
     uint8_t border;
-    Window root;
+    xcb_window_t root;
 };
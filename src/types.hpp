@@ -13,6 +13,9 @@ enum border_t : uint8_t {
     HIDE
 };
 
+// steps of mouse_pos_t::pos along a border
+static const int RESOLUTION = 65536;
+
 struct mouse_pos_t {
     uint8_t screen;
     uint8_t border;
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include "uinput_pointer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+static const char UINPUT_PATH[] = "/dev/uinput";
+static const uint16_t WEY_VENDOR_ID = 0x1b07;
+
+uinput_pointer::uinput_pointer(logger & log, int width, int height)
+    : log(log)
+    , width(width)
+    , height(height) {
+
+    create();
+}
+
+uinput_pointer::~uinput_pointer() {
+    destroy();
+}
+
+void uinput_pointer::create() {
+    fd = file_descriptor(::open(UINPUT_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC));
+    if (!fd.valid()) {
+        throw std::system_error(errno, std::system_category(), "failed to open " + std::string(UINPUT_PATH));
+    }
+
+    // an absolute pointer with a button is classified as a mouse (like virtual machine tablets),
+    // not as a touchscreen or tablet
+    if (ioctl(*fd, UI_SET_EVBIT, EV_KEY) < 0 || ioctl(*fd, UI_SET_KEYBIT, BTN_LEFT) < 0
+        || ioctl(*fd, UI_SET_EVBIT, EV_ABS) < 0 || ioctl(*fd, UI_SET_ABSBIT, ABS_X) < 0
+        || ioctl(*fd, UI_SET_ABSBIT, ABS_Y) < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to set uinput capabilities");
+    }
+
+    for (auto [code, size] : { std::pair { ABS_X, width }, std::pair { ABS_Y, height } }) {
+        struct uinput_abs_setup abs = {};
+        abs.code = code;
+        abs.absinfo.minimum = 0;
+        abs.absinfo.maximum = size - 1;
+        if (ioctl(*fd, UI_ABS_SETUP, &abs) < 0) {
+            throw std::system_error(errno, std::system_category(), "failed to set up uinput axis");
+        }
+    }
+
+    struct uinput_setup setup = {};
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = WEY_VENDOR_ID;
+    std::strncpy(setup.name, UINPUT_DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+    if (ioctl(*fd, UI_DEV_SETUP, &setup) < 0 || ioctl(*fd, UI_DEV_CREATE) < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to create uinput device");
+    }
+
+    // a new device starts at the minimum of its axes
+    cur_x = 0;
+    cur_y = 0;
+    log.info("created uinput pointer " + std::to_string(width) + "x" + std::to_string(height));
+}
+
+void uinput_pointer::destroy() {
+    if (fd.valid()) {
+        ioctl(*fd, UI_DEV_DESTROY);
+        fd.close();
+    }
+}
+
+bool uinput_pointer::resize(int w, int h) {
+    if (w == width && h == height) {
+        return false;
+    }
+
+    // the axis ranges are fixed once the device exists
+    destroy();
+    width = w;
+    height = h;
+    create();
+    return true;
+}
+
+std::optional<int> uinput_pointer::move(int x, int y) {
+    x = std::clamp(x, 0, width - 1);
+    y = std::clamp(y, 0, height - 1);
+
+    // the kernel drops values equal to the current one, the pointer may have been moved by another
+    // device since. a frame one unit aside first makes the placement a change again.
+    std::optional<int> step;
+    if (x == cur_x && y == cur_y) {
+        step = x > 0 ? x - 1 : x + 1;
+        write_frame(*step, y);
+    }
+    write_frame(x, y);
+    return step;
+}
+
+void uinput_pointer::write_frame(int x, int y) {
+    std::array<input_event, 3> events = {};
+    events[0].type = EV_ABS;
+    events[0].code = ABS_X;
+    events[0].value = x;
+    events[1].type = EV_ABS;
+    events[1].code = ABS_Y;
+    events[1].value = y;
+    events[2].type = EV_SYN;
+    events[2].code = SYN_REPORT;
+
+    if (::write(*fd, events.data(), sizeof(events)) != sizeof(events)) {
+        throw std::system_error(errno, std::system_category(), "failed to write uinput events");
+    }
+    cur_x = x;
+    cur_y = y;
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#pragma once
+
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <optional>
+
+#include "file_descriptor.hpp"
+#include "logger.hpp"
+
+static const char UINPUT_DEVICE_NAME[] = "lmss pointer";
+
+// Absolute pointer device created through /dev/uinput. The pointer is placed with EV_ABS events
+// like a tablet would place it, the events take the normal input path instead of a warp inside the
+// X server. The axes cover the screen pixel by pixel, the server maps the device to the whole
+// screen.
+class uinput_pointer final {
+public:
+    uinput_pointer(logger &, int width, int height);
+    ~uinput_pointer();
+
+    uinput_pointer(uinput_pointer const &) = delete;
+    uinput_pointer & operator=(uinput_pointer const &) = delete;
+
+    // returns the x of the frame written one unit aside first, if the placement needed one
+    std::optional<int> move(int x, int y);
+    // returns whether the device was created again, the server picks it up some time later
+    bool resize(int width, int height);
+
+private:
+    void create();
+    void destroy();
+    void write_frame(int x, int y);
+
+    logger & log;
+    file_descriptor fd;
+    int width;
+    int height;
+    // last values written to the axes
+    int cur_x = 0;
+    int cur_y = 0;
+};
@@ -4,7 +4,10 @@
 
 #include <sys/timerfd.h>
 
+#include <endian.h>
+
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <functional>
@@ -14,6 +17,17 @@
 
 static const char USB_PATH[] = "/dev/bus/usb";
 static const unsigned int TRANSFER_TIMEOUT = 50;
+static const uint16_t WEY_VENDOR_ID = 0x1b07;
+static const uint16_t WEY_PRODUCT_MIN = 0x1000;
+static const uint16_t WEY_PRODUCT_MAX = 0x10ff;
+static const uint8_t WEY_INTERFACE = 2;
+static const size_t MAX_DESCRIPTORS_SIZE = 4096;
+static const uint16_t MIN_PACKET_SIZE = 6;
+static const long DEFAULT_POLL_INTERVAL = 10 * 1000 * 1000L;
+static const long MIN_POLL_INTERVAL = 1000 * 1000L;
+static const long IDLE_POLL_INTERVAL = 100 * 1000 * 1000L;
+static const std::chrono::milliseconds BORDER_TIMEOUT(250);
+static const unsigned int BORDER_RETRIES = 3;
 
 usb_dev::usb_dev(logger & log, context & ctx)
     : log(log)
@@ -51,20 +65,37 @@ usb_dev::usb_dev(logger & log, context & ctx)
                << std::setfill('0') << std::setw(4) << desc.idProduct << std::dec;
             log.info(ss.str());
 
-            if (desc.idVendor == 0x1b07 && desc.idProduct >= 0x1000 && desc.idProduct <= 0x10ff) {
-                hid_fd = std::move(fd);
+            if (desc.idVendor != WEY_VENDOR_ID
+                || desc.idProduct < WEY_PRODUCT_MIN || desc.idProduct > WEY_PRODUCT_MAX) {
+                continue;
+            }
+
+            // usbfs returns the configuration descriptors right after the device descriptor
+            std::vector<uint8_t> config(MAX_DESCRIPTORS_SIZE);
+            size = ::read(*fd, config.data(), config.size());
+            if (size == -1) {
+                throw std::system_error(errno, std::system_category(), "failed to read usb config descriptor");
+            }
+            config.resize(size);
 
-                detach_kernel_driver();
+            auto found = find_interface(config);
+            if (!found) {
+                log.info("no usable interface found, skipping device");
+                continue;
+            }
 
-                unsigned int iface = 2;
+            iface = *found;
+            hid_fd = std::move(fd);
 
-                if (ioctl(*hid_fd, USBDEVFS_CLAIMINTERFACE, &iface) < 0) {
-                    throw std::system_error(errno, std::system_category(), "failed to claim hid dev");
-                }
-                heartbeat();
+            detach_kernel_driver();
 
-                break;
+            unsigned int ifno = iface.number;
+            if (ioctl(*hid_fd, USBDEVFS_CLAIMINTERFACE, &ifno) < 0) {
+                throw std::system_error(errno, std::system_category(), "failed to claim hid dev");
             }
+            heartbeat();
+
+            break;
         }
     }
 
@@ -72,26 +103,143 @@ usb_dev::usb_dev(logger & log, context & ctx)
         throw std::runtime_error("wey usb device not found");
     }
 
+    start_poll_timer();
+
+    ctx.get_el().add_fd(*tfd, std::bind(&usb_dev::handle_events, this, std::placeholders::_1));
+    read_mouse_pos();
+}
+
+std::optional<usb_dev::interface_t> usb_dev::find_interface(std::vector<uint8_t> const & config) const {
+    struct candidate_t {
+        interface_t iface;
+        uint8_t cls;
+    };
+    std::vector<candidate_t> candidates;
+
+    // only the first configuration is considered, the device comes with a single one
+    if (config.size() >= USB_DT_CONFIG_SIZE && config[1] == USB_DT_CONFIG) {
+        size_t off = config[0];
+        auto total = std::min<size_t>(config.size(), config[2] | config[3] << 8);
+        bool cur = false;
+
+        while (off + 2 <= total) {
+            auto len = config[off];
+            auto type = config[off + 1];
+            if (len < 2 || off + len > total) {
+                log.warn("malformed usb config descriptor");
+                break;
+            }
+
+            if (type == USB_DT_INTERFACE && len >= USB_DT_INTERFACE_SIZE) {
+                struct usb_interface_descriptor id;
+                std::memcpy(&id, &config[off], USB_DT_INTERFACE_SIZE);
+
+                // alternate settings and boot keyboards/mice are never the control interface
+                bool boot = id.bInterfaceClass == USB_CLASS_HID && id.bInterfaceSubClass == 1;
+                cur = id.bAlternateSetting == 0 && !boot;
+                if (cur) {
+                    candidates.push_back({ .iface = { .number = id.bInterfaceNumber }, .cls = id.bInterfaceClass });
+                }
+            } else if (type == USB_DT_ENDPOINT && len >= USB_DT_ENDPOINT_SIZE && cur) {
+                struct usb_endpoint_descriptor ed = {};
+                std::memcpy(&ed, &config[off], USB_DT_ENDPOINT_SIZE);
+
+                auto xfer = ed.bmAttributes & USB_ENDPOINT_XFERTYPE_MASK;
+                if (xfer == USB_ENDPOINT_XFER_INT || xfer == USB_ENDPOINT_XFER_BULK) {
+                    auto & i = candidates.back().iface;
+                    auto & ep = (ed.bEndpointAddress & USB_DIR_IN) ? i.in : i.out;
+                    if (!ep.address) {
+                        ep = endpoint_t {
+                            .address = ed.bEndpointAddress,
+                            .type = static_cast<uint8_t>(xfer),
+                            .max_packet_size = static_cast<uint16_t>(le16toh(ed.wMaxPacketSize) & 0x07ff),
+                            .interval = ed.bInterval
+                        };
+                    }
+                }
+            } else if (type == USB_DT_CONFIG) {
+                break;
+            }
+
+            off += len;
+        }
+    }
+
+    auto usable = [](candidate_t const & c) {
+        return c.iface.in.address && c.iface.out.address
+            && c.iface.in.max_packet_size >= MIN_PACKET_SIZE && c.iface.out.max_packet_size >= MIN_PACKET_SIZE;
+    };
+
+    // the known devices control the pointer through interface 2, another revision may have moved it to
+    // another vendor specific or HID interface
+    std::optional<interface_t> found;
+    auto known = std::find_if(candidates.begin(), candidates.end(), [&](auto const & c) {
+        return c.iface.number == WEY_INTERFACE && usable(c);
+    });
+    if (known != candidates.end()) {
+        found = known->iface;
+    } else {
+        auto other = std::find_if(candidates.begin(), candidates.end(), [&](auto const & c) {
+            return (c.cls == USB_CLASS_VENDOR_SPEC || c.cls == USB_CLASS_HID) && usable(c);
+        });
+        if (other != candidates.end()) {
+            log.warn("interface " + std::to_string(WEY_INTERFACE) + " is not usable, falling back to interface "
+                + std::to_string(other->iface.number) + " from the config descriptor");
+            found = other->iface;
+        }
+    }
+
+    if (found) {
+        std::stringstream ss;
+        ss << "using interface " << static_cast<int>(found->number) << std::hex
+           << " in: 0x" << static_cast<int>(found->in.address)
+           << " out: 0x" << static_cast<int>(found->out.address) << std::dec
+           << " type: " << (found->in.type == USB_ENDPOINT_XFER_INT ? "interrupt" : "bulk")
+           << " packet size: " << found->in.max_packet_size << "/" << found->out.max_packet_size
+           << " interval: " << static_cast<int>(found->in.interval);
+        log.info(ss.str());
+    }
+
+    return found;
+}
+
+void usb_dev::start_poll_timer() {
+    long interval = DEFAULT_POLL_INTERVAL;
+
+    if (iface.in.type == USB_ENDPOINT_XFER_INT && iface.in.interval > 0) {
+        auto speed = ioctl(*hid_fd, USBDEVFS_GET_SPEED, NULL);
+        if (speed >= USB_SPEED_HIGH) {
+            // high speed and above: 2^(bInterval-1) microframes of 125us
+            interval = 125 * 1000L << (std::min<int>(iface.in.interval, 16) - 1);
+        } else {
+            interval = iface.in.interval * 1000 * 1000L;
+        }
+        interval = std::max(interval, MIN_POLL_INTERVAL);
+    }
+
+    poll_interval = interval;
+    arm_poll_timer(interval);
+}
+
+void usb_dev::arm_poll_timer(long interval) {
+    log.debug("polling usb device every " + std::to_string(interval / 1000) + "us");
+
     struct itimerspec ts = {};
-    ts.it_interval.tv_sec = 0;
-    ts.it_interval.tv_nsec = 10 * 1000 * 1000;
-    ts.it_value.tv_sec = 0;
-    ts.it_value.tv_nsec = 10 * 1000 * 1000;
+    ts.it_interval.tv_sec = interval / (1000 * 1000 * 1000L);
+    ts.it_interval.tv_nsec = interval % (1000 * 1000 * 1000L);
+    ts.it_value = ts.it_interval;
 
     if (timerfd_settime(*tfd, 0, &ts, NULL) < 0) {
         throw std::system_error(errno, std::system_category(), "failed to arm timer");
     }
-
-    ctx.get_el().add_fd(*tfd, std::bind(&usb_dev::handle_events, this, std::placeholders::_1));
-    read_mouse_pos();
 }
 
 void usb_dev::submit_transfer(transfer_t & t) {
     log.debug("submitting transfer " + std::to_string(t.id));
     auto urb = &t.urb;
     urb->usercontext = &t.id;
-    urb->type = USBDEVFS_URB_TYPE_INTERRUPT;
-    urb->endpoint = 0x03 | USB_DIR_IN;
+    urb->type = iface.in.type == USB_ENDPOINT_XFER_INT ? USBDEVFS_URB_TYPE_INTERRUPT : USBDEVFS_URB_TYPE_BULK;
+    urb->endpoint = iface.in.address;
     urb->buffer = t.buf.data();
     urb->buffer_length = t.buf.size();
 
@@ -110,6 +258,8 @@ void usb_dev::handle_events(int) {
     }
     while (reap()) { }
 
+    check_border_timeout();
+
     if (transfers.empty()) {
         read_mouse_pos();
     }
@@ -130,7 +280,7 @@ bool usb_dev::reap() {
         throw std::system_error(-urb->status, std::system_category(), "unhandled urb status");
     }
 
-    if (urb->endpoint == (0x03 | USB_DIR_IN)) {
+    if (urb->endpoint == iface.in.address) {
         auto buf = static_cast<uint8_t*>(urb->buffer);
         std::stringstream ss("wey packet: ");
         for (auto i = 0; i < urb->actual_length; ++i) {
@@ -141,12 +291,17 @@ bool usb_dev::reap() {
 
         if (buf[0] == 0x05 && buf[1] == 0x00) {
             last_sent_pos.reset();
+            if (buf[3] == border_t::HIDE) {
+                // we switched away, a pending border of this PC is stale now
+                pending_pos.reset();
+            }
             ctx.set_mouse_pos({
                 .screen = buf[2],
                 .border = buf[3],
                 .pos = static_cast<uint16_t>((static_cast<uint16_t>(buf[5]) << 8) | static_cast<uint16_t>(buf[4]))
             });
             done();
+            send_pending_border();
         }
     } else {
         log.debug("send completed");
@@ -159,79 +314,123 @@ bool usb_dev::reap() {
     return true;
 }
 
-void usb_dev::heartbeat() {
-    log.debug("sending heartbeat");
-    std::array<uint8_t, 64> buf {};
-    buf[0] = 0x05;
+void usb_dev::set_idle(bool idle) {
+    if (idle == this->idle) {
+        return;
+    }
+    this->idle = idle;
 
-    struct usbdevfs_bulktransfer data {
-        .ep = 3,
-        .len = buf.size(),
-        .timeout = TRANSFER_TIMEOUT,
-        .data = buf.data()
-    };
+    // nobody is working on this PC, only a switch to it has to be picked up. the heartbeat keeps
+    // going, the device needs it to see the PC.
+    arm_poll_timer(idle ? std::max(poll_interval, IDLE_POLL_INTERVAL) : poll_interval);
+}
 
-    if (ioctl(*hid_fd, USBDEVFS_BULK, &data) < 0) {
-        throw std::system_error(errno, std::system_category(), "failed to send heartbeat");
-    }
+void usb_dev::heartbeat() {
+    log.debug("sending heartbeat");
+    auto buf = packet(0x00);
+    send(buf, "heartbeat");
 }
 
 void usb_dev::read_mouse_pos() {
     auto & t = transfers.emplace_back(transfer_t{});
     t.id = last_id++;
+    t.buf.resize(iface.in.max_packet_size);
     submit_transfer(t);
 }
 
 void usb_dev::send_mouse_pos(mouse_pos_t const & mp) {
     if (last_sent_pos.has_value()) {
-        log.debug("skipping border since we're still waiting for the position cmd of the last border");
+        // only one border exchange is in flight, the newest border replaces a pending one and is sent
+        // as soon as the device answered the current one
+        if (mp.screen == last_sent_pos->screen && mp.border == last_sent_pos->border) {
+            log.debug("skipping border since we're still waiting for the position cmd of the same border");
+            pending_pos.reset();
+        } else {
+            log.debug("border pending until the position cmd of the last border arrived");
+            pending_pos = mp;
+        }
         return;
     }
 
     last_sent_pos = mp;
+    border_retries = 0;
+    border_timeout = BORDER_TIMEOUT;
+    send_border(mp);
+}
 
-    std::array<uint8_t, 64> buf {};
-    buf[0] = 0x05;
-    buf[1] = 0x01;
+void usb_dev::send_border(mouse_pos_t const & mp) {
+    border_deadline = std::chrono::steady_clock::now() + border_timeout;
+
+    auto buf = packet(0x01);
     buf[2] = mp.screen;
     buf[3] = mp.border;
     buf[4] = mp.pos & 0x00ff;
     buf[5] = mp.pos >> 8;
+    send(buf, "mouse pos");
 
-    struct usbdevfs_bulktransfer data {
-        .ep = 3,
-        .len = buf.size(),
-        .timeout = TRANSFER_TIMEOUT,
-        .data = buf.data()
-    };
+    done();
+}
 
-    if (ioctl(*hid_fd, USBDEVFS_BULK, &data) < 0) {
-        throw std::system_error(errno, std::system_category(), "failed to send done");
+void usb_dev::send_pending_border() {
+    if (!pending_pos.has_value()) {
+        return;
     }
 
-    done();
+    auto mp = *pending_pos;
+    pending_pos.reset();
+    log.debug("sending pending border");
+    send_mouse_pos(mp);
+}
+
+void usb_dev::check_border_timeout() {
+    if (!last_sent_pos.has_value() || std::chrono::steady_clock::now() < border_deadline) {
+        return;
+    }
+
+    border_timeouts++;
+
+    if (border_retries >= BORDER_RETRIES) {
+        log.warn("no position cmd for border after " + std::to_string(border_retries) + " retries, giving up"
+            + " (timeouts: " + std::to_string(border_timeouts) + ")");
+        last_sent_pos.reset();
+        send_pending_border();
+        return;
+    }
+
+    border_retries++;
+    border_timeout *= 2;
+    log.warn("no position cmd for border, retransmitting (timeouts: " + std::to_string(border_timeouts) + ")");
+    send_border(*last_sent_pos);
 }
 
 void usb_dev::done() {
-    std::array<uint8_t, 64> buf {};
+    auto buf = packet(0x02);
+    send(buf, "done");
+}
+
+std::vector<uint8_t> usb_dev::packet(uint8_t cmd) const {
+    std::vector<uint8_t> buf(iface.out.max_packet_size);
     buf[0] = 0x05;
-    buf[1] = 0x02;
+    buf[1] = cmd;
+    return buf;
+}
 
+void usb_dev::send(std::vector<uint8_t> & buf, std::string const & what) {
     struct usbdevfs_bulktransfer data {
-        .ep = 3,
-        .len = buf.size(),
+        .ep = iface.out.address,
+        .len = static_cast<unsigned int>(buf.size()),
         .timeout = TRANSFER_TIMEOUT,
         .data = buf.data()
     };
 
     if (ioctl(*hid_fd, USBDEVFS_BULK, &data) < 0) {
-        throw std::system_error(errno, std::system_category(), "failed to send done");
+        throw std::system_error(errno, std::system_category(), "failed to send " + what);
     }
 }
 
 void usb_dev::detach_kernel_driver() {
     struct usbdevfs_getdriver getdrv = { };
-    getdrv.interface = 2;
+    getdrv.interface = iface.number;
 
     if (ioctl(*hid_fd, USBDEVFS_GETDRIVER, &getdrv) < 0) {
         log.debug("usbdevfs getdriver failed, should be fine since we can claim the interface now");
@@ -244,7 +443,7 @@ void usb_dev::detach_kernel_driver() {
     }
 
     struct usbdevfs_ioctl command {
-        .ifno = 2,
+        .ifno = iface.number,
         .ioctl_code = USBDEVFS_DISCONNECT,
         .data = NULL
     };
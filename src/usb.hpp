@@ -9,7 +9,9 @@
 #include <fcntl.h>
 
 #include <array>
+#include <chrono>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "context.hpp"
@@ -24,15 +26,38 @@ public:
 
     void heartbeat();
     void send_mouse_pos(mouse_pos_t const &);
+    void set_idle(bool);
 
 private:
+    struct endpoint_t {
+        uint8_t address = 0;
+        uint8_t type = 0;
+        uint16_t max_packet_size = 0;
+        uint8_t interval = 0;
+    };
+
+    struct interface_t {
+        uint8_t number = 0;
+        endpoint_t in = {};
+        endpoint_t out = {};
+    };
+
     struct transfer_t {
         uint64_t id;
-        std::array<uint8_t, 64> buf;
+        std::vector<uint8_t> buf;
         usbdevfs_urb urb;
     };
 
+    std::optional<interface_t> find_interface(std::vector<uint8_t> const & config) const;
+    void start_poll_timer();
+    void arm_poll_timer(long interval);
+    std::vector<uint8_t> packet(uint8_t cmd) const;
+    void send(std::vector<uint8_t> & buf, std::string const & what);
+
     void handle_events(int);
+    void send_border(mouse_pos_t const &);
+    void send_pending_border();
+    void check_border_timeout();
     void done();
     void detach_kernel_driver();
 
@@ -46,5 +71,13 @@ private:
     context & ctx;
     file_descriptor hid_fd;
     file_descriptor tfd;
+    interface_t iface;
+    long poll_interval = 0;
+    bool idle = false;
     std::optional<mouse_pos_t> last_sent_pos;
+    std::optional<mouse_pos_t> pending_pos;
+    std::chrono::steady_clock::time_point border_deadline;
+    std::chrono::milliseconds border_timeout;
+    unsigned int border_retries = 0;
+    uint64_t border_timeouts = 0;
 };
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+// Benchmarks the border classification of the screen layout on a video wall of equal monitors,
+// one position at a time and in batches. The positions are a random walk over the wall or a
+// recorded trace with one "x y" pair per line.
+//
+//   lmss-bench [-t TRACE] [COLUMNS ROWS [POSITIONS]]
+//
+// Prints the positions per second of both entry points and the number of positions that hit an
+// external border strip.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "layout.hpp"
+
+using clk = std::chrono::steady_clock;
+
+static const int MONITOR_WIDTH = 1920;
+static const int MONITOR_HEIGHT = 1080;
+static const xcb_window_t ROOT = 1;
+static const size_t BATCH = 4096;
+
+static std::vector<layout::position_t> random_walk(layout const & l, size_t count) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> step(-24, 24);
+    std::vector<layout::position_t> positions;
+    positions.reserve(count);
+
+    int x = l.width() / 2;
+    int y = l.height() / 2;
+    for (size_t i = 0; i < count; ++i) {
+        x = std::clamp(x + step(rng), 0, l.width() - 1);
+        y = std::clamp(y + step(rng), 0, l.height() - 1);
+        positions.push_back({ x, y, ROOT });
+    }
+
+    return positions;
+}
+
+static std::vector<layout::position_t> read_trace(std::string const & path) {
+    std::ifstream f(path);
+    if (!f) {
+        std::cerr << "failed to open " << path << std::endl;
+        std::exit(1);
+    }
+
+    std::vector<layout::position_t> positions;
+    int x, y;
+    while (f >> x >> y) {
+        positions.push_back({ x, y, ROOT });
+    }
+
+    return positions;
+}
+
+static void report(char const * what, size_t count, clk::duration d, size_t hits) {
+    auto s = std::chrono::duration<double>(d).count();
+    std::cout << what << ": " << count << " positions in " << s * 1000 << " ms, "
+              << static_cast<long>(count / s) << " positions/s, " << hits << " border hits" << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    std::string trace;
+    std::vector<long> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            trace = argv[++i];
+        } else {
+            args.push_back(std::atol(arg.c_str()));
+        }
+    }
+
+    int columns = args.size() > 0 ? args[0] : 8;
+    int rows = args.size() > 1 ? args[1] : 4;
+    size_t count = args.size() > 2 ? args[2] : 10 * 1000 * 1000;
+    if (columns <= 0 || rows <= 0) {
+        std::cerr << "usage: " << argv[0] << " [-t TRACE] [COLUMNS ROWS [POSITIONS]]" << std::endl;
+        return 1;
+    }
+
+    layout l;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            l.add_monitor(r * columns + c, c * MONITOR_WIDTH, r * MONITOR_HEIGHT, MONITOR_WIDTH, MONITOR_HEIGHT,
+                ROOT, 1);
+        }
+    }
+    l.finalize();
+
+    auto positions = trace.empty() ? random_walk(l, count) : read_trace(trace);
+    std::cout << columns << "x" << rows << " monitors, " << positions.size() << " positions" << std::endl;
+
+    size_t hits = 0;
+    auto start = clk::now();
+    for (auto const & p : positions) {
+        hits += l.classify(p.x, p.y, p.root) >= 0;
+    }
+    report("single", positions.size(), clk::now() - start, hits);
+
+    std::vector<int> out(BATCH);
+    hits = 0;
+    start = clk::now();
+    for (size_t i = 0; i < positions.size(); i += BATCH) {
+        auto n = std::min(BATCH, positions.size() - i);
+        l.classify(std::span(positions).subspan(i, n), out);
+        hits += std::count_if(out.begin(), out.begin() + n, [](int idx) { return idx >= 0; });
+    }
+    report("batch", positions.size(), clk::now() - start, hits);
+
+    return 0;
+}
@@ -0,0 +1,713 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+// Emulates a WEY device on top of the dummy_hcd and raw_gadget kernel modules, lmss attaches to
+// it like to real hardware. This allows running lmss and benchmarking enumeration, claiming, URB
+// reaping and reconnects without transmitter hardware.
+//
+//   modprobe dummy_hcd
+//   modprobe raw_gadget
+//   lmss-emu [SCRIPT|-]
+//
+// Script commands, one per line, '#' starts a comment:
+//   delay <ms>                      delay before a border is answered (default 5)
+//   reply echo|hide|none            answer borders with the same position, with HIDE or not at all
+//   reply <screen> <border> <pos>   answer borders with a fixed position
+//   drop <n>                        don't answer the next n borders
+//   pos <screen> <border> <pos>     send a position to the host
+//   sleep <ms>                      pause the script
+//   wait <n>                        wait until n borders have been received in total
+//   stats                           print counters and latencies
+//   quit                            print stats and exit
+//
+// Once the script is done the emulator keeps serving the host until it receives SIGINT/SIGTERM.
+// Reconnects can be measured by restarting the emulator in a loop, every start reports the time
+// to enumeration and to the first heartbeat (interface claimed).
+
+#include <linux/usb/ch9.h>
+#include <linux/usb/raw_gadget.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "file_descriptor.hpp"
+
+using clk = std::chrono::steady_clock;
+
+static const char RAW_GADGET[] = "/dev/raw-gadget";
+static const char UDC_DRIVER[] = "dummy_udc";
+static const char UDC_DEVICE[] = "dummy_udc.0";
+
+static const uint16_t VENDOR_ID = 0x1b07;
+static const uint16_t PRODUCT_ID = 0x1001;
+static const uint8_t NUM_INTERFACES = 3;
+static const uint8_t IFACE_NUM = 2;
+static const uint8_t EP_NUM = 3;
+static const uint16_t PACKET_SIZE = 64;
+static const uint8_t EP_INTERVAL = 4;  // 2^(4-1) * 125us = 1ms at high speed
+static const uint8_t MAX_POWER = 50;  // in 2mA units
+static const size_t EP0_MAX_DATA = 256;
+
+static const uint8_t HIDE = 4;
+
+static std::ostream & out() {
+    auto ts = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::cout << ts / 1000 << "." << ts % 1000 << " ";
+}
+
+// the usb threads have nobody to report to, any error ends the emulator
+template<typename F>
+static void spawn(F && f) {
+    std::thread([f = std::forward<F>(f)]() {
+        try {
+            f();
+        } catch (std::exception const & e) {
+            std::cerr << e.what() << std::endl;
+            _exit(1);
+        }
+    }).detach();
+}
+
+struct mouse_pos_t {
+    uint8_t screen;
+    uint8_t border;
+    uint16_t pos;
+};
+
+class stats final {
+public:
+    void count(std::string const & name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        counters[name]++;
+    }
+
+    void add(std::string const & name, clk::duration d) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto & s = samples[name];
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        s.min = s.count == 0 ? us : std::min(s.min, us);
+        s.max = std::max(s.max, us);
+        s.sum += us;
+        s.count++;
+    }
+
+    void print() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto const & [name, c] : counters) {
+            std::cout << name << ": " << c << std::endl;
+        }
+        for (auto const & [name, s] : samples) {
+            std::cout << name << ": n=" << s.count << " min=" << s.min << "us avg=" << s.sum / s.count
+                      << "us max=" << s.max << "us" << std::endl;
+        }
+    }
+
+private:
+    struct sample_t {
+        int64_t count = 0;
+        int64_t sum = 0;
+        int64_t min = 0;
+        int64_t max = 0;
+    };
+
+    std::mutex mtx;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, sample_t> samples;
+};
+
+class wey_emu final {
+public:
+    wey_emu();
+
+    void run_script(std::istream &);
+    void print_stats() { st.print(); }
+
+private:
+    // usb_raw_event and usb_raw_ep_io end in flexible arrays, these mirror their layout with a
+    // fixed size payload
+    struct control_event_t {
+        uint32_t type;
+        uint32_t length;
+        usb_ctrlrequest ctrl;
+    };
+
+    template<size_t N>
+    struct ep_io_t {
+        uint16_t ep;
+        uint16_t flags;
+        uint32_t length;
+        uint8_t data[N];
+    };
+
+    struct pending_t {
+        clk::time_point when;
+        mouse_pos_t mp;
+        std::optional<clk::time_point> border;
+
+        bool operator>(pending_t const & other) const { return when > other.when; }
+    };
+
+    void ep0_loop();
+    void out_loop();
+    void in_loop();
+
+    bool handle_control(usb_ctrlrequest const &, ep_io_t<EP0_MAX_DATA> &);
+    void pick_endpoints();
+    void set_configuration();
+    void handle_packet(uint8_t const * buf, size_t len);
+    void queue_pos(mouse_pos_t const &, std::chrono::milliseconds delay, std::optional<clk::time_point> border);
+
+    std::vector<uint8_t> config_descriptor() const;
+
+    file_descriptor fd;
+    stats st;
+    clk::time_point started;
+    std::optional<clk::time_point> configured;
+
+    uint8_t ep_in_addr = USB_DIR_IN | EP_NUM;
+    uint8_t ep_out_addr = USB_DIR_OUT | EP_NUM;
+    int ep_in = -1;
+    int ep_out = -1;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::priority_queue<pending_t, std::vector<pending_t>, std::greater<pending_t>> pending;
+    std::chrono::milliseconds delay { 5 };
+    enum { ECHO, REPLY_HIDE, REPLY_NONE, FIXED } reply = ECHO;
+    mouse_pos_t fixed_pos {};
+    uint64_t drop = 0;
+    uint64_t borders = 0;
+
+    std::optional<clk::time_point> last_heartbeat;
+    std::optional<clk::time_point> last_border;
+    bool claimed = false;
+};
+
+wey_emu::wey_emu()
+    : fd(::open(RAW_GADGET, O_RDWR | O_CLOEXEC)) {
+
+    if (!fd.valid()) {
+        throw std::system_error(errno, std::system_category(), "failed to open raw-gadget, is raw_gadget loaded?");
+    }
+
+    struct usb_raw_init init = {};
+    std::strncpy(reinterpret_cast<char *>(init.driver_name), UDC_DRIVER, UDC_NAME_LENGTH_MAX - 1);
+    std::strncpy(reinterpret_cast<char *>(init.device_name), UDC_DEVICE, UDC_NAME_LENGTH_MAX - 1);
+    init.speed = USB_SPEED_HIGH;
+
+    if (ioctl(*fd, USB_RAW_IOCTL_INIT, &init) < 0) {
+        throw std::system_error(errno, std::system_category(), "raw-gadget init failed, is dummy_hcd loaded?");
+    }
+
+    started = clk::now();
+    if (ioctl(*fd, USB_RAW_IOCTL_RUN, 0) < 0) {
+        throw std::system_error(errno, std::system_category(), "raw-gadget run failed");
+    }
+
+    spawn([this]() { ep0_loop(); });
+}
+
+void wey_emu::ep0_loop() {
+    for (;;) {
+        control_event_t ev = {};
+        ev.length = sizeof(ev.ctrl);
+
+        if (ioctl(*fd, USB_RAW_IOCTL_EVENT_FETCH, &ev) < 0) {
+            throw std::system_error(errno, std::system_category(), "raw-gadget event fetch failed");
+        }
+
+        if (ev.type == USB_RAW_EVENT_CONNECT) {
+            pick_endpoints();
+            continue;
+        }
+
+        if (ev.type != USB_RAW_EVENT_CONTROL) {
+            continue;
+        }
+
+        ep_io_t<EP0_MAX_DATA> io = {};
+        if (!handle_control(ev.ctrl, io)) {
+            ioctl(*fd, USB_RAW_IOCTL_EP0_STALL, 0);
+            continue;
+        }
+
+        if (ev.ctrl.bRequestType & USB_DIR_IN) {
+            io.length = std::min<uint32_t>(io.length, le16toh(ev.ctrl.wLength));
+            if (ioctl(*fd, USB_RAW_IOCTL_EP0_WRITE, &io) < 0) {
+                out() << "ep0 write failed: " << std::strerror(errno) << std::endl;
+            }
+        } else {
+            io.length = le16toh(ev.ctrl.wLength);
+            if (ioctl(*fd, USB_RAW_IOCTL_EP0_READ, &io) < 0) {
+                out() << "ep0 read failed: " << std::strerror(errno) << std::endl;
+            }
+        }
+
+        if (ev.ctrl.bRequest == USB_REQ_SET_CONFIGURATION && !configured) {
+            configured = clk::now();
+            st.add("enumeration", *configured - started);
+            out() << "enumerated" << std::endl;
+
+            spawn([this]() { out_loop(); });
+            spawn([this]() { in_loop(); });
+        }
+    }
+}
+
+void wey_emu::pick_endpoints() {
+    struct usb_raw_eps_info info = {};
+    auto num = ioctl(*fd, USB_RAW_IOCTL_EPS_INFO, &info);
+    if (num < 0) {
+        throw std::system_error(errno, std::system_category(), "raw-gadget eps info failed");
+    }
+
+    // the real device uses endpoint 3 in both directions, not every UDC offers an interrupt endpoint
+    // with that address, lmss discovers the endpoints from the descriptor anyway
+    auto pick = [&](bool in) -> std::optional<uint8_t> {
+        std::optional<uint8_t> any;
+        for (auto i = 0; i < num; ++i) {
+            auto const & ep = info.eps[i];
+            if (!ep.caps.type_int || !(in ? ep.caps.dir_in : ep.caps.dir_out)) {
+                continue;
+            }
+
+            if (ep.addr == EP_NUM || ep.addr == USB_RAW_EP_ADDR_ANY) {
+                return EP_NUM;
+            }
+
+            if (!any) {
+                any = ep.addr;
+            }
+        }
+        return any;
+    };
+
+    auto in = pick(true);
+    auto out_ep = pick(false);
+    if (!in || !out_ep) {
+        throw std::runtime_error("udc has no interrupt endpoints");
+    }
+
+    ep_in_addr = USB_DIR_IN | *in;
+    ep_out_addr = USB_DIR_OUT | *out_ep;
+
+    if (*in != EP_NUM || *out_ep != EP_NUM) {
+        out() << "udc has no interrupt endpoint " << static_cast<int>(EP_NUM) << ", using in: "
+              << static_cast<int>(*in) << " out: " << static_cast<int>(*out_ep) << std::endl;
+    }
+}
+
+std::vector<uint8_t> wey_emu::config_descriptor() const {
+    std::vector<uint8_t> buf;
+
+    struct usb_config_descriptor config = {};
+    config.bLength = USB_DT_CONFIG_SIZE;
+    config.bDescriptorType = USB_DT_CONFIG;
+    config.bNumInterfaces = NUM_INTERFACES;
+    config.bConfigurationValue = 1;
+    config.bmAttributes = USB_CONFIG_ATT_ONE | USB_CONFIG_ATT_SELFPOWER;
+    config.bMaxPower = MAX_POWER;
+
+    auto append = [&](void const * d, size_t len) {
+        auto p = static_cast<uint8_t const *>(d);
+        buf.insert(buf.end(), p, p + len);
+    };
+
+    append(&config, USB_DT_CONFIG_SIZE);
+
+    // interfaces 0 and 1 stand in for the keyboard/mouse functions of the real device
+    for (uint8_t i = 0; i < NUM_INTERFACES; ++i) {
+        struct usb_interface_descriptor iface = {};
+        iface.bLength = USB_DT_INTERFACE_SIZE;
+        iface.bDescriptorType = USB_DT_INTERFACE;
+        iface.bInterfaceNumber = i;
+        iface.bNumEndpoints = i == IFACE_NUM ? 2 : 0;
+        iface.bInterfaceClass = USB_CLASS_VENDOR_SPEC;
+        append(&iface, USB_DT_INTERFACE_SIZE);
+    }
+
+    for (auto addr : { ep_in_addr, ep_out_addr }) {
+        struct usb_endpoint_descriptor ep = {};
+        ep.bLength = USB_DT_ENDPOINT_SIZE;
+        ep.bDescriptorType = USB_DT_ENDPOINT;
+        ep.bEndpointAddress = addr;
+        ep.bmAttributes = USB_ENDPOINT_XFER_INT;
+        ep.wMaxPacketSize = htole16(PACKET_SIZE);
+        ep.bInterval = EP_INTERVAL;
+        append(&ep, USB_DT_ENDPOINT_SIZE);
+    }
+
+    auto total = htole16(buf.size());
+    std::memcpy(&buf[2], &total, sizeof(total));
+    return buf;
+}
+
+bool wey_emu::handle_control(usb_ctrlrequest const & ctrl, ep_io_t<EP0_MAX_DATA> & io) {
+    io.ep = 0;
+    io.flags = 0;
+    io.length = 0;
+
+    auto set = [&](void const * d, size_t len) {
+        len = std::min(len, sizeof(io.data));
+        std::memcpy(io.data, d, len);
+        io.length = len;
+        return true;
+    };
+
+    if ((ctrl.bRequestType & USB_TYPE_MASK) != USB_TYPE_STANDARD) {
+        return false;
+    }
+
+    switch (ctrl.bRequest) {
+        case USB_REQ_GET_DESCRIPTOR: {
+            auto type = le16toh(ctrl.wValue) >> 8;
+            auto index = le16toh(ctrl.wValue) & 0xff;
+
+            if (type == USB_DT_DEVICE) {
+                struct usb_device_descriptor dev = {};
+                dev.bLength = USB_DT_DEVICE_SIZE;
+                dev.bDescriptorType = USB_DT_DEVICE;
+                dev.bcdUSB = htole16(0x0200);
+                dev.bMaxPacketSize0 = 64;
+                dev.idVendor = htole16(VENDOR_ID);
+                dev.idProduct = htole16(PRODUCT_ID);
+                dev.bcdDevice = htole16(0x0100);
+                dev.iManufacturer = 1;
+                dev.iProduct = 2;
+                dev.bNumConfigurations = 1;
+                return set(&dev, USB_DT_DEVICE_SIZE);
+            } else if (type == USB_DT_DEVICE_QUALIFIER) {
+                struct usb_qualifier_descriptor q = {};
+                q.bLength = sizeof(q);
+                q.bDescriptorType = USB_DT_DEVICE_QUALIFIER;
+                q.bcdUSB = htole16(0x0200);
+                q.bMaxPacketSize0 = 64;
+                q.bNumConfigurations = 1;
+                return set(&q, sizeof(q));
+            } else if (type == USB_DT_CONFIG) {
+                auto config = config_descriptor();
+                return set(config.data(), config.size());
+            } else if (type == USB_DT_STRING) {
+                std::string str;
+                switch (index) {
+                    case 0: {
+                        uint8_t langs[] = { 4, USB_DT_STRING, 0x09, 0x04 };
+                        return set(langs, sizeof(langs));
+                    }
+                    case 1: str = "WEY Technology AG"; break;
+                    case 2: str = "WEY device emulator"; break;
+                    default: return false;
+                }
+
+                std::vector<uint8_t> buf { static_cast<uint8_t>(2 + 2 * str.size()), USB_DT_STRING };
+                for (auto c : str) {
+                    buf.push_back(c);
+                    buf.push_back(0);
+                }
+                return set(buf.data(), buf.size());
+            }
+            return false;
+        }
+        case USB_REQ_SET_CONFIGURATION:
+            if (ep_in < 0) {
+                set_configuration();
+            }
+            return true;
+        case USB_REQ_SET_INTERFACE:
+            return true;
+        case USB_REQ_GET_STATUS: {
+            uint16_t status = 0;
+            return set(&status, sizeof(status));
+        }
+        default:
+            return false;
+    }
+}
+
+void wey_emu::set_configuration() {
+    for (auto addr : { ep_in_addr, ep_out_addr }) {
+        struct usb_endpoint_descriptor ep = {};
+        ep.bLength = USB_DT_ENDPOINT_SIZE;
+        ep.bDescriptorType = USB_DT_ENDPOINT;
+        ep.bEndpointAddress = addr;
+        ep.bmAttributes = USB_ENDPOINT_XFER_INT;
+        ep.wMaxPacketSize = htole16(PACKET_SIZE);
+        ep.bInterval = EP_INTERVAL;
+
+        auto handle = ioctl(*fd, USB_RAW_IOCTL_EP_ENABLE, &ep);
+        if (handle < 0) {
+            throw std::system_error(errno, std::system_category(), "failed to enable endpoint");
+        }
+        (addr & USB_DIR_IN ? ep_in : ep_out) = handle;
+    }
+
+    uint32_t power = 2 * MAX_POWER;
+    if (ioctl(*fd, USB_RAW_IOCTL_VBUS_DRAW, power) < 0) {
+        throw std::system_error(errno, std::system_category(), "raw-gadget vbus draw failed");
+    }
+
+    if (ioctl(*fd, USB_RAW_IOCTL_CONFIGURE, 0) < 0) {
+        throw std::system_error(errno, std::system_category(), "raw-gadget configure failed");
+    }
+}
+
+void wey_emu::out_loop() {
+    for (;;) {
+        ep_io_t<PACKET_SIZE> io = {};
+        io.ep = ep_out;
+        io.length = sizeof(io.data);
+
+        auto len = ioctl(*fd, USB_RAW_IOCTL_EP_READ, &io);
+        if (len < 0) {
+            throw std::system_error(errno, std::system_category(), "raw-gadget ep read failed");
+        }
+
+        handle_packet(io.data, len);
+    }
+}
+
+void wey_emu::handle_packet(uint8_t const * buf, size_t len) {
+    auto now = clk::now();
+
+    if (len < 2 || buf[0] != 0x05) {
+        st.count("invalid packets");
+        return;
+    }
+
+    if (!claimed) {
+        claimed = true;
+        st.add("claim", now - *configured);
+        out() << "interface claimed" << std::endl;
+    }
+
+    switch (buf[1]) {
+        case 0x00:
+            st.count("heartbeats");
+            if (last_heartbeat) {
+                st.add("heartbeat interval", now - *last_heartbeat);
+            }
+            last_heartbeat = now;
+            break;
+        case 0x01: {
+            if (len < 6) {
+                st.count("invalid packets");
+                return;
+            }
+
+            mouse_pos_t mp {
+                .screen = buf[2],
+                .border = buf[3],
+                .pos = static_cast<uint16_t>(buf[4] | buf[5] << 8)
+            };
+            out() << "border screen: " << static_cast<int>(mp.screen) << " border: " << static_cast<int>(mp.border)
+                  << " pos: " << mp.pos << std::endl;
+            st.count("borders");
+            last_border = now;
+
+            std::lock_guard<std::mutex> lock(mtx);
+            borders++;
+            cv.notify_all();
+
+            if (drop > 0) {
+                drop--;
+                st.count("dropped replies");
+                break;
+            }
+
+            switch (reply) {
+                case ECHO: break;
+                case REPLY_HIDE: mp.border = HIDE; break;
+                case FIXED: mp = fixed_pos; break;
+                case REPLY_NONE: return;
+            }
+            pending.push({ now + delay, mp, now });
+            cv.notify_all();
+            break;
+        }
+        case 0x02:
+            st.count("dones");
+            if (last_border) {
+                st.add("border to done", now - *last_border);
+                last_border.reset();
+            }
+            break;
+        default:
+            st.count("unknown packets");
+    }
+}
+
+void wey_emu::queue_pos(mouse_pos_t const & mp, std::chrono::milliseconds d, std::optional<clk::time_point> border) {
+    std::lock_guard<std::mutex> lock(mtx);
+    pending.push({ clk::now() + d, mp, border });
+    cv.notify_all();
+}
+
+void wey_emu::in_loop() {
+    for (;;) {
+        pending_t p;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for (;;) {
+                if (pending.empty()) {
+                    cv.wait(lock);
+                } else if (pending.top().when > clk::now()) {
+                    cv.wait_until(lock, pending.top().when);
+                } else {
+                    break;
+                }
+            }
+            p = pending.top();
+            pending.pop();
+        }
+
+        ep_io_t<PACKET_SIZE> io = {};
+        io.ep = ep_in;
+        io.length = sizeof(io.data);
+        io.data[0] = 0x05;
+        io.data[1] = 0x00;
+        io.data[2] = p.mp.screen;
+        io.data[3] = p.mp.border;
+        io.data[4] = p.mp.pos & 0x00ff;
+        io.data[5] = p.mp.pos >> 8;
+
+        // blocks until lmss reaps the packet with its pending URB
+        if (ioctl(*fd, USB_RAW_IOCTL_EP_WRITE, &io) < 0) {
+            throw std::system_error(errno, std::system_category(), "raw-gadget ep write failed");
+        }
+
+        st.count("positions");
+        if (p.border) {
+            st.add("border to position", clk::now() - *p.border);
+        }
+    }
+}
+
+void wey_emu::run_script(std::istream & in) {
+    for (std::string line; std::getline(in, line);) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string cmd;
+        if (!(ss >> cmd)) {
+            continue;
+        }
+
+        auto read_pos = [&]() {
+            int screen, border, pos;
+            if (!(ss >> screen >> border >> pos)) {
+                throw std::runtime_error("expected <screen> <border> <pos>: " + line);
+            }
+            return mouse_pos_t {
+                .screen = static_cast<uint8_t>(screen),
+                .border = static_cast<uint8_t>(border),
+                .pos = static_cast<uint16_t>(pos)
+            };
+        };
+
+        auto read_num = [&]() {
+            uint64_t n;
+            if (!(ss >> n)) {
+                throw std::runtime_error("expected a number: " + line);
+            }
+            return n;
+        };
+
+        if (cmd == "delay") {
+            auto d = std::chrono::milliseconds(read_num());
+            std::lock_guard<std::mutex> lock(mtx);
+            delay = d;
+        } else if (cmd == "reply") {
+            std::string mode;
+            auto pos = ss.tellg();
+            ss >> mode;
+            std::lock_guard<std::mutex> lock(mtx);
+            if (mode == "echo") {
+                reply = ECHO;
+            } else if (mode == "hide") {
+                reply = REPLY_HIDE;
+            } else if (mode == "none") {
+                reply = REPLY_NONE;
+            } else {
+                ss.clear();
+                ss.seekg(pos);
+                fixed_pos = read_pos();
+                reply = FIXED;
+            }
+        } else if (cmd == "drop") {
+            auto n = read_num();
+            std::lock_guard<std::mutex> lock(mtx);
+            drop = n;
+        } else if (cmd == "pos") {
+            queue_pos(read_pos(), std::chrono::milliseconds(0), std::nullopt);
+        } else if (cmd == "sleep") {
+            std::this_thread::sleep_for(std::chrono::milliseconds(read_num()));
+        } else if (cmd == "wait") {
+            auto n = read_num();
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&]() { return borders >= n; });
+        } else if (cmd == "stats") {
+            print_stats();
+        } else if (cmd == "quit") {
+            print_stats();
+            std::exit(0);
+        } else {
+            throw std::runtime_error("unknown command: " + line);
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 2 || (argc == 2 && std::string(argv[1]) == "--help")) {
+        std::cerr << "usage: " << argv[0] << " [SCRIPT|-]" << std::endl;
+        return 1;
+    }
+
+    // handle termination in the main thread only, the usb threads inherit the mask
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+
+    try {
+        wey_emu emu;
+
+        if (argc == 2 && std::string(argv[1]) == "-") {
+            emu.run_script(std::cin);
+        } else if (argc == 2) {
+            std::ifstream script(argv[1]);
+            if (!script) {
+                throw std::runtime_error(std::string("failed to open script ") + argv[1]);
+            }
+            emu.run_script(script);
+        }
+
+        int sig;
+        sigwait(&sigs, &sig);
+        emu.print_stats();
+    } catch (std::exception const & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}